@@ -0,0 +1,120 @@
+// hot paths of DesktopView on the offscreen platform.
+// usage: benchmark [item counts...], default 100 1000 10000 50000
+// output csv: case,items,iterations,ns_per_iteration
+
+#include <QApplication>
+#include <QScreen>
+#include <QStandardItemModel>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QRubberBand>
+#include <QTextStream>
+#include <QImage>
+#include <QtMath>
+
+#include "desktop-view.h"
+#include "test-fixtures.h"
+
+#include <functional>
+
+// exposes the slots measured by the benchmark
+class BenchmarkView : public DesktopView
+{
+public:
+    using DesktopView::relayoutItems;
+    using DesktopView::setSelection;
+    using DesktopView::handleScreenChanged;
+    using DesktopView::saveItemsPositions;
+};
+
+int main(int argc, char *argv[])
+{
+    // 基准测试不需要真实的显示
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+
+    QList<int> counts;
+    for (auto arg : a.arguments().mid(1)) {
+        if (arg.toInt() > 0)
+            counts<<arg.toInt();
+    }
+    if (counts.isEmpty()) {
+        counts<<100<<1000<<10000<<50000;
+    }
+
+    QTextStream out(stdout);
+    out<<"case,items,iterations,ns_per_iteration\n";
+    auto measure = [&](const char *name, int count, int iterations, std::function<void (int)> f) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++) {
+            f(i);
+        }
+        out<<name<<","<<count<<","<<iterations<<","<<timer.nsecsElapsed() / iterations<<"\n";
+        out.flush();
+    };
+
+    QTemporaryDir benchmarkDir;
+    QIcon icon = QIcon::fromTheme("text-plain");
+    for (int count : counts) {
+        QStandardItemModel benchmarkModel;
+        benchmarkModel.invisibleRootItem()->appendRows(createTestItems("benchmark", count, icon));
+
+        BenchmarkView view;
+        view.setPositionStorePath(benchmarkDir.filePath(QString("item-positions-%1").arg(count)));
+        view.resize(1920, 1080);
+        view.show();
+        // one screen large enough for all items, painting only looks at a 1920x1080 window of it
+        int side = qCeil(qSqrt(count));
+        view.getScreen(0)->onScreenGeometryChanged(QRect(0, 0, side * 100, side * 150));
+        view.flushPendingLayout();
+        view.setModel(&benchmarkModel);
+        const auto ids = view.layoutEngine().visibleItems();
+        auto screen = view.getScreen(0);
+        const auto geometry = screen->getGeometry();
+
+        for (auto id : ids) {
+            screen->makeItemGridPosInvalid(id);
+        }
+        measure("placeItem", count, ids.count(), [&](int i) {
+            screen->placeItem(ids.at(i));
+        });
+
+        measure("relayoutItems", count, 10, [&](int) {
+            view.relayoutItems(ids);
+        });
+
+        QRandomGenerator random(count);
+        QVector<QPoint> points;
+        for (int i = 0; i < 10000; i++) {
+            points<<QPoint(random.bounded(geometry.width()), random.bounded(geometry.height()));
+        }
+        measure("indexAt", count, points.count(), [&](int i) {
+            view.indexAt(points.at(i));
+        });
+
+        // rubber band selection over one screen of items
+        view.findChild<QRubberBand *>()->setVisible(true);
+        measure("setSelection", count, 100, [&](int i) {
+            view.setSelection(QRect(i, i, 1920, 1080), QItemSelectionModel::ClearAndSelect);
+        });
+        view.findChild<QRubberBand *>()->setVisible(false);
+        view.selectionModel()->clear();
+
+        QImage image(1920, 1080, QImage::Format_ARGB32_Premultiplied);
+        measure("paintEvent", count, 50, [&](int) {
+            view.viewport()->render(&image);
+        });
+
+        measure("handleScreenChanged", count, 10, [&](int) {
+            view.handleScreenChanged(screen);
+        });
+
+        measure("saveItemsPositions", count, 10, [&](int) {
+            view.saveItemsPositions();
+        });
+    }
+
+    return 0;
+}
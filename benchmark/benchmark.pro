@@ -0,0 +1,32 @@
+QT       += core gui gui-private widgets widgets-private
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+# qmake CONFIG+=trace, see src/trace.h
+trace: DEFINES += DESKTOP_VIEW_TRACE
+
+# only the view under test, no file system model or thumbnails.
+INCLUDEPATH += ../src
+
+SOURCES += \
+    benchmark.cpp \
+    ../src/desktop-view.cpp \
+    ../src/icon-pixmap-cache.cpp \
+    ../src/item-position-store.cpp \
+    ../src/item-table.cpp \
+    ../src/label-layout-cache.cpp \
+    ../src/layout-engine.cpp \
+    ../src/screen.cpp \
+    ../src/trace.cpp
+
+HEADERS += \
+    ../src/desktop-view.h \
+    ../src/icon-pixmap-cache.h \
+    ../src/item-position-store.h \
+    ../src/item-table.h \
+    ../src/label-layout-cache.h \
+    ../src/layout-engine.h \
+    ../src/screen.h \
+    ../src/test-fixtures.h \
+    ../src/trace.h
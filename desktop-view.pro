@@ -1,16 +1,40 @@
-QT       += core gui gui-private
+QT       += core gui gui-private concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets widgets-private
 
 CONFIG += c++11
 
+# qmake CONFIG+=trace, see src/trace.h
+trace: DEFINES += DESKTOP_VIEW_TRACE
+
 SOURCES += \
+    directory-loader.cpp \
+    directory-watcher.cpp \
     filesystem-model.cpp \
+    thumbnail-provider.cpp \
     src/desktop-view.cpp \
+    src/event-log.cpp \
     src/example.cpp \
-    src/screen.cpp
+    src/icon-pixmap-cache.cpp \
+    src/item-position-store.cpp \
+    src/item-table.cpp \
+    src/label-layout-cache.cpp \
+    src/layout-engine.cpp \
+    src/screen.cpp \
+    src/trace.cpp
 
 HEADERS += \
+    directory-loader.h \
+    directory-watcher.h \
     filesystem-model.h \
+    thumbnail-provider.h \
     src/desktop-view.h \
-    src/screen.h
+    src/event-log.h \
+    src/icon-pixmap-cache.h \
+    src/item-position-store.h \
+    src/item-table.h \
+    src/label-layout-cache.h \
+    src/layout-engine.h \
+    src/screen.h \
+    src/test-fixtures.h \
+    src/trace.h
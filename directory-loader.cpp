@@ -0,0 +1,85 @@
+#include "directory-loader.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMimeDatabase>
+#include <QUrl>
+#include <QtConcurrent/QtConcurrentMap>
+
+DirectoryLoader::DirectoryLoader(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<DirectoryEntry>();
+    qRegisterMetaType<QVector<DirectoryEntry>>();
+}
+
+DirectoryEntry DirectoryLoader::statEntry(const QString &path)
+{
+    QFileInfo info(path);
+    DirectoryEntry entry;
+    // deleted after it was listed or reported, broken symlinks are still entries.
+    if (!info.exists() && !info.isSymLink())
+        return entry;
+
+    entry.name = info.fileName();
+    entry.uri = fileUri(info.absoluteFilePath());
+    entry.isDir = info.isDir();
+    entry.size = info.size();
+    entry.modifiedTime = info.lastModified().toMSecsSinceEpoch();
+    if (entry.isDir) {
+        entry.iconName = "folder";
+    } else {
+        // match by name only, reading file content is too slow here.
+        static QMimeDatabase db;
+        auto mime = db.mimeTypeForFile(info, QMimeDatabase::MatchExtension);
+        entry.iconName = mime.iconName();
+    }
+    return entry;
+}
+
+QString DirectoryLoader::fileUri(const QString &path)
+{
+    return QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath()).toString();
+}
+
+void DirectoryLoader::cancel()
+{
+    m_generation.fetchAndAddOrdered(1);
+}
+
+int DirectoryLoader::generation() const
+{
+    return m_generation.load();
+}
+
+void DirectoryLoader::load(const QString &path, int generation, int batchSize)
+{
+    QStringList paths;
+    QDirIterator it(path, QDir::AllEntries|QDir::NoDotAndDotDot|QDir::System);
+    while (it.hasNext()) {
+        paths<<it.next();
+    }
+
+    if (loadBatches(paths, generation, batchSize)) {
+        Q_EMIT finished(generation);
+    }
+}
+
+void DirectoryLoader::loadEntries(const QStringList &paths, int generation, int batchSize)
+{
+    loadBatches(paths, generation, batchSize);
+}
+
+bool DirectoryLoader::loadBatches(const QStringList &paths, int generation, int batchSize)
+{
+    for (int i = 0; i < paths.count(); i += batchSize) {
+        if (generation != m_generation.load()) {
+            // canceled
+            return false;
+        }
+        auto entries = QtConcurrent::blockingMapped<QVector<DirectoryEntry>>(paths.mid(i, batchSize), &DirectoryLoader::statEntry);
+        Q_EMIT entriesLoaded(generation, entries);
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef DIRECTORYLOADER_H
+#define DIRECTORYLOADER_H
+
+#include <QObject>
+#include <QVector>
+#include <QAtomicInt>
+#include <QMetaType>
+
+struct DirectoryEntry
+{
+    QString name;
+    QString uri;
+    QString iconName;
+    qint64 size = 0;
+    qint64 modifiedTime = 0; //msecs since epoch
+    bool isDir = false;
+
+    bool isValid() const {return !name.isEmpty();}
+};
+Q_DECLARE_METATYPE(DirectoryEntry)
+Q_DECLARE_METATYPE(QVector<DirectoryEntry>)
+
+// enumerates a directory in its own thread, entries are stated in parallel
+// and delivered in batches.
+class DirectoryLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DirectoryLoader(QObject *parent = nullptr);
+
+    static DirectoryEntry statEntry(const QString &path); //invalid if the file is gone
+    static QString fileUri(const QString &path); //uri of entries
+
+    void cancel(); //thread safe, drop the loading job
+    int generation() const;
+
+signals:
+    void entriesLoaded(int generation, const QVector<DirectoryEntry> &entries);
+    void finished(int generation);
+
+public slots:
+    void load(const QString &path, int generation, int batchSize = 256);
+    void loadEntries(const QStringList &paths, int generation, int batchSize = 256); //without finished()
+
+private:
+    bool loadBatches(const QStringList &paths, int generation, int batchSize);
+
+    QAtomicInt m_generation;
+};
+
+#endif // DIRECTORYLOADER_H
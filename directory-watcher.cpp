@@ -0,0 +1,231 @@
+#include "directory-watcher.h"
+
+#include <QSocketNotifier>
+#include <QFile>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+DirectoryWatcher::DirectoryWatcher(QObject *parent) : QObject(parent)
+{
+    // apply changes at most once per frame
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(16);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DirectoryWatcher::flush);
+
+#ifdef Q_OS_LINUX
+    m_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if (m_fd < 0) {
+        qCritical()<<"inotify init failed";
+        return;
+    }
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    // activated() is overloaded since 5.15, qOverload needs c++14.
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    connect(m_notifier, QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated), this, &DirectoryWatcher::readEvents);
+#else
+    connect(m_notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+#endif
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0)
+        close(m_fd);
+#endif
+}
+
+bool DirectoryWatcher::setPath(const QString &path)
+{
+    clearPending();
+    m_path = path;
+
+#ifdef Q_OS_LINUX
+    if (m_fd < 0)
+        return false;
+
+    if (m_wd >= 0) {
+        inotify_rm_watch(m_fd, m_wd);
+        m_wd = -1;
+    }
+    if (path.isEmpty())
+        return false;
+
+    uint32_t mask = IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|IN_ATTRIB|IN_DELETE_SELF|IN_MOVE_SELF;
+    m_wd = inotify_add_watch(m_fd, QFile::encodeName(path).constData(), mask);
+    if (m_wd < 0) {
+        qWarning()<<"can not watch"<<path;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+QString DirectoryWatcher::path() const
+{
+    return m_path;
+}
+
+void DirectoryWatcher::setInterval(int msecs)
+{
+    m_flushTimer.setInterval(msecs);
+}
+
+void DirectoryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        auto len = read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            auto event = reinterpret_cast<const struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                clearPending();
+                Q_EMIT overflowed();
+                return;
+            }
+            if (event->wd == m_wd && event->mask & (IN_DELETE_SELF|IN_MOVE_SELF)) {
+                // the listing is gone with the directory, pending changes do not matter.
+                clearPending();
+                inotify_rm_watch(m_fd, m_wd);
+                m_wd = -1;
+                Q_EMIT removed();
+                return;
+            }
+            if (event->wd != m_wd || event->len == 0)
+                continue;
+
+            auto name = QFile::decodeName(event->name);
+            // the two halves of a rename are adjacent, any other event ends the wait for IN_MOVED_TO.
+            bool pairedMove = event->mask & IN_MOVED_TO && !m_movedFromName.isEmpty() && event->cookie == m_movedFromCookie;
+            if (!pairedMove)
+                dropMovedFrom();
+
+            if (pairedMove) {
+                onRenamed(m_movedFromName, name);
+                m_movedFromName.clear();
+            } else if (event->mask & IN_MOVED_FROM) {
+                m_movedFromCookie = event->cookie;
+                m_movedFromName = name;
+            } else if (event->mask & (IN_CREATE|IN_MOVED_TO)) {
+                onCreated(name);
+            } else if (event->mask & IN_DELETE) {
+                onDeleted(name);
+            } else if (event->mask & (IN_CLOSE_WRITE|IN_ATTRIB)) {
+                onModified(name);
+            }
+        }
+    }
+
+    bool pending = !(m_created.isEmpty() && m_deleted.isEmpty() && m_modified.isEmpty() && m_renamed.isEmpty() && m_movedFromName.isEmpty());
+    if (!m_flushTimer.isActive() && pending) {
+        m_flushTimer.start();
+    }
+#endif
+}
+
+void DirectoryWatcher::flush()
+{
+    // moved out of the directory
+    dropMovedFrom();
+
+    QStringList created = m_created.values();
+    QStringList deleted = m_deleted.values();
+    QStringList modified = m_modified.values();
+    QHash<QString, QString> renamed = m_renamed;
+    m_created.clear();
+    m_deleted.clear();
+    m_modified.clear();
+    m_renamed.clear();
+
+    Q_EMIT changed(created, deleted, modified, renamed);
+}
+
+void DirectoryWatcher::clearPending()
+{
+    m_flushTimer.stop();
+    m_created.clear();
+    m_deleted.clear();
+    m_modified.clear();
+    m_renamed.clear();
+    m_movedFromName.clear();
+}
+
+void DirectoryWatcher::dropMovedFrom()
+{
+    if (m_movedFromName.isEmpty())
+        return;
+    onDeleted(m_movedFromName);
+    m_movedFromName.clear();
+}
+
+void DirectoryWatcher::onCreated(const QString &name)
+{
+    if (m_deleted.remove(name)) {
+        // replaced in this frame, the row is still there.
+        m_modified<<name;
+    } else {
+        m_created<<name;
+    }
+}
+
+void DirectoryWatcher::onDeleted(const QString &name)
+{
+    m_modified.remove(name);
+    auto oldName = m_renamed.take(name);
+    if (!oldName.isEmpty()) {
+        // the renamed row goes, and the row the rename may have replaced.
+        m_deleted<<oldName<<name;
+        return;
+    }
+    if (!m_created.remove(name)) {
+        m_deleted<<name;
+    }
+}
+
+void DirectoryWatcher::onModified(const QString &name)
+{
+    if (!m_created.contains(name)) {
+        m_modified<<name;
+    }
+}
+
+void DirectoryWatcher::onRenamed(const QString &from, const QString &to)
+{
+    if (from == to)
+        return;
+
+    if (m_created.remove(from)) {
+        // there is no row to rename yet
+        onCreated(to);
+        return;
+    }
+
+    // a file created or renamed to the new name in this frame is replaced.
+    m_created.remove(to);
+    m_modified.remove(to);
+    auto replaced = m_renamed.take(to);
+    if (!replaced.isEmpty())
+        m_deleted<<replaced;
+
+    auto oldName = m_renamed.take(from);
+    if (oldName.isEmpty())
+        oldName = from;
+    bool modified = m_modified.remove(from);
+    if (oldName != to)
+        m_renamed.insert(to, oldName);
+    if (modified)
+        m_modified<<to;
+}
@@ -0,0 +1,60 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QObject>
+#include <QSet>
+#include <QHash>
+#include <QTimer>
+
+class QSocketNotifier;
+
+// watches one directory with inotify (linux only). bursts of changes are
+// coalesced by file name and reported at most once per frame.
+// a move inside the directory is reported as a rename, a move out of it as a delete.
+class DirectoryWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DirectoryWatcher(QObject *parent = nullptr);
+    ~DirectoryWatcher() override;
+
+    bool setPath(const QString &path);
+    QString path() const;
+
+    void setInterval(int msecs);
+
+signals:
+    // renamed: new name -> old name, modified names are the new ones
+    void changed(const QStringList &created, const QStringList &deleted, const QStringList &modified, const QHash<QString, QString> &renamed);
+    void overflowed(); //events lost, directory should be loaded again
+    void removed(); //watched directory was deleted or moved away, not watched any more
+
+private slots:
+    void readEvents();
+    void flush();
+
+private:
+    void onCreated(const QString &name);
+    void onDeleted(const QString &name);
+    void onModified(const QString &name);
+    void onRenamed(const QString &from, const QString &to);
+    void dropMovedFrom();
+    void clearPending();
+
+    QString m_path;
+    int m_fd = -1;
+    int m_wd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+
+    QTimer m_flushTimer;
+    QSet<QString> m_created;
+    QSet<QString> m_deleted;
+    QSet<QString> m_modified;
+    QHash<QString, QString> m_renamed; //new name -> old name
+
+    // IN_MOVED_FROM waiting for the IN_MOVED_TO of the same cookie, a delete if none follows.
+    quint32 m_movedFromCookie = 0;
+    QString m_movedFromName;
+};
+
+#endif // DIRECTORYWATCHER_H
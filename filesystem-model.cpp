@@ -1,20 +1,407 @@
 #include "filesystem-model.h"
 
-#include <QIcon>
+#include <QDir>
+#include <QTimer>
+#include <QPixmap>
 
-FileSystemModel::FileSystemModel(QObject *parent) : QStandardItemModel(parent)
+FileSystemModel::FileSystemModel(QObject *parent) : QAbstractListModel(parent)
 {
+    m_loader = new DirectoryLoader;
+    m_loader->moveToThread(&m_loaderThread);
+    connect(&m_loaderThread, &QThread::finished, m_loader, &QObject::deleteLater);
+    connect(m_loader, &DirectoryLoader::entriesLoaded, this, &FileSystemModel::onEntriesLoaded);
+    connect(m_loader, &DirectoryLoader::finished, this, &FileSystemModel::onLoadFinished);
+    m_loaderThread.start();
 
+    connect(&m_watcher, &DirectoryWatcher::changed, this, &FileSystemModel::onDirectoryChanged);
+    connect(&m_watcher, &DirectoryWatcher::overflowed, this, [=](){
+        setRootPath(m_rootPath);
+    });
+    // load again and re-arm the watcher, the listing is empty if the path does not exist any more.
+    connect(&m_watcher, &DirectoryWatcher::removed, this, [=](){
+        setRootPath(m_rootPath);
+    });
+
+    connect(&m_thumbnailProvider, &ThumbnailProvider::thumbnailReady, this, &FileSystemModel::onThumbnailReady);
+}
+
+FileSystemModel::~FileSystemModel()
+{
+    m_loader->cancel();
+    m_loaderThread.quit();
+    m_loaderThread.wait();
+}
+
+void FileSystemModel::setRootPath(const QString &path)
+{
+    m_loader->cancel();
+    m_generation = m_loader->generation();
+
+    m_thumbnailProvider.cancelAll();
+
+    beginResetModel();
+    m_rootPath = path;
+    m_entries.clear();
+    m_names.clear();
+    m_thumbnails.clear();
+    m_pendingThumbnails.clear();
+    endResetModel();
+
+    // watch before listing, so that no change is missed. duplicated entries are dropped.
+    m_watcher.setPath(path);
+
+    m_loading = true;
+    m_firstBatchLatency = -1;
+    m_loadTime = -1;
+    m_loadTimer.start();
+    QMetaObject::invokeMethod(m_loader, "load", Qt::QueuedConnection, Q_ARG(QString, path), Q_ARG(int, m_generation), Q_ARG(int, 256));
+}
+
+QString FileSystemModel::rootPath() const
+{
+    return m_rootPath;
+}
+
+bool FileSystemModel::isLoading() const
+{
+    return m_loading;
+}
+
+qint64 FileSystemModel::firstBatchLatency() const
+{
+    return m_firstBatchLatency;
+}
+
+qint64 FileSystemModel::loadTime() const
+{
+    return m_loadTime;
+}
+
+int FileSystemModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_entries.count();
 }
 
 QVariant FileSystemModel::data(const QModelIndex &index, int role) const
 {
-    if (role == Qt::DecorationRole) {
-        return QIcon::fromTheme("folder");
+    if (!index.isValid() || index.row() >= m_entries.count())
+        return QVariant();
+
+    const auto &entry = m_entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return entry.name;
+    case Qt::DecorationRole: {
+        auto it = m_thumbnails.constFind(entry.uri);
+        if (it != m_thumbnails.constEnd())
+            return it.value();
+        return iconFromTheme(entry.iconName);
+    }
+    case Qt::UserRole:
+        return entry.uri;
+    default:
+        return QVariant();
+    }
+}
+
+bool FileSystemModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || row < 0 || count <= 0 || row + count > m_entries.count())
+        return false;
+
+    beginRemoveRows(parent, row, row + count - 1);
+    for (int i = row; i < row + count; i++) {
+        const auto &entry = m_entries.at(i);
+        m_names.remove(entry.name);
+        m_thumbnails.remove(entry.uri);
+        m_thumbnailProvider.cancel(entry.uri);
+    }
+    m_entries.remove(row, count);
+    endRemoveRows();
+    return true;
+}
+
+void FileSystemModel::onEntriesLoaded(int generation, const QVector<DirectoryEntry> &entries)
+{
+    if (generation != m_generation)
+        return;
+
+    // entries of existing names are modified files, or duplicates of the listing and the watcher.
+    QVector<DirectoryEntry> newEntries;
+    QHash<QString, DirectoryEntry> changedEntries;
+    newEntries.reserve(entries.count());
+    for (auto entry : entries) {
+        if (!entry.isValid())
+            continue;
+        if (m_names.contains(entry.name)) {
+            changedEntries.insert(entry.name, entry);
+            continue;
+        }
+        m_names<<entry.name;
+        newEntries<<entry;
+    }
+    if (!changedEntries.isEmpty()) {
+        updateEntries(changedEntries);
+    }
+    if (newEntries.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), m_entries.count(), m_entries.count() + newEntries.count() - 1);
+    m_entries<<newEntries;
+    endInsertRows();
+
+    // thumbnails of visible items will be prioritized by view.
+    for (const auto &entry : newEntries) {
+        if (ThumbnailProvider::canThumbnail(entry.iconName)) {
+            m_thumbnailProvider.requestThumbnail(entry.uri, entry.modifiedTime);
+        }
+    }
+
+    if (m_firstBatchLatency < 0) {
+        m_firstBatchLatency = m_loadTimer.elapsed();
+        Q_EMIT firstBatchLoaded(m_firstBatchLatency);
+    }
+}
+
+void FileSystemModel::updateEntries(const QHash<QString, DirectoryEntry> &entries)
+{
+    QVector<int> rows;
+    for (int row = 0; row < m_entries.count(); row++) {
+        auto it = entries.constFind(m_entries.at(row).name);
+        if (it == entries.constEnd())
+            continue;
+
+        auto &entry = m_entries[row];
+        const auto &newEntry = it.value();
+        if (entry.modifiedTime == newEntry.modifiedTime && entry.size == newEntry.size
+                && entry.iconName == newEntry.iconName && entry.isDir == newEntry.isDir)
+            continue;
+
+        entry = newEntry;
+        if (ThumbnailProvider::canThumbnail(entry.iconName)) {
+            m_thumbnailProvider.cancel(entry.uri);
+            m_thumbnailProvider.requestThumbnail(entry.uri, entry.modifiedTime, true);
+        }
+        rows<<row;
+    }
+    emitRowsChanged(rows, {Qt::DecorationRole});
+}
+
+void FileSystemModel::emitRowsChanged(const QVector<int> &rows, const QVector<int> &roles)
+{
+    for (int i = 0; i < rows.count();) {
+        int first = rows.at(i);
+        int last = first;
+        for (i++; i < rows.count() && rows.at(i) == last + 1; i++) {
+            last = rows.at(i);
+        }
+        Q_EMIT dataChanged(index(first, 0), index(last, 0), roles);
+    }
+}
+
+void FileSystemModel::onLoadFinished(int generation)
+{
+    if (generation != m_generation)
+        return;
+
+    m_loading = false;
+    m_loadTime = m_loadTimer.elapsed();
+    Q_EMIT loadFinished(m_loadTime);
+}
+
+void FileSystemModel::onDirectoryChanged(const QStringList &created, const QStringList &deleted, const QStringList &modified, const QHash<QString, QString> &renamed)
+{
+    QSet<QString> deletedNames;
+    for (auto name : deleted) {
+        deletedNames<<name;
+    }
+
+    // a row keeps its place through a rename, unless the new name is still taken by
+    // the old name of another rename (swap, chain). those are deleted and created again.
+    QSet<QString> oldNames;
+    for (auto oldName : renamed) {
+        oldNames<<oldName;
+    }
+    QHash<QString, QString> renamedRows;
+    QStringList recreated;
+    for (auto it = renamed.constBegin(); it != renamed.constEnd(); it++) {
+        if (oldNames.contains(it.key())) {
+            deletedNames<<it.value();
+            recreated<<it.key();
+        } else if (m_names.contains(it.value())) {
+            if (m_names.contains(it.key())) {
+                // replaced by the rename
+                deletedNames<<it.key();
+            }
+            renamedRows.insert(it.key(), it.value());
+        } else {
+            recreated<<it.key();
+        }
+    }
+
+    // a renamed row is not deleted, even if its old name is taken again and deleted in the same frame.
+    for (auto oldName : renamedRows) {
+        deletedNames.remove(oldName);
+    }
+
+    if (!deletedNames.isEmpty()) {
+        removeEntries(deletedNames);
+    }
+    if (!renamedRows.isEmpty()) {
+        renameEntries(renamedRows);
+    }
+
+    // created and modified rows are stated by loader, no stat or mime lookup in gui thread.
+    QStringList paths;
+    QDir dir(m_rootPath);
+    for (auto name : created) {
+        if (!m_names.contains(name))
+            paths<<dir.filePath(name);
+    }
+    for (auto name : recreated) {
+        if (!m_names.contains(name))
+            paths<<dir.filePath(name);
+    }
+    // a modified name without a row is loaded as created, renamed files may have got another icon.
+    for (auto name : modified) {
+        paths<<dir.filePath(name);
+    }
+    for (auto name : renamedRows.keys()) {
+        paths<<dir.filePath(name);
+    }
+    if (!paths.isEmpty()) {
+        QMetaObject::invokeMethod(m_loader, "loadEntries", Qt::QueuedConnection, Q_ARG(QStringList, paths), Q_ARG(int, m_generation), Q_ARG(int, 256));
+    }
+}
+
+void FileSystemModel::removeEntries(const QSet<QString> &names)
+{
+    // deleted rows are moved to the end in one layout change, and removed as one block.
+    QVector<int> keptRows;
+    QVector<int> deletedRows;
+    keptRows.reserve(m_entries.count());
+    for (int row = 0; row < m_entries.count(); row++) {
+        if (names.contains(m_entries.at(row).name)) {
+            deletedRows<<row;
+        } else {
+            keptRows<<row;
+        }
+    }
+    if (deletedRows.isEmpty())
+        return;
+
+    bool contiguous = deletedRows.last() - deletedRows.first() + 1 == deletedRows.count();
+    if (contiguous) {
+        removeRows(deletedRows.first(), deletedRows.count());
+        return;
+    }
+
+    Q_EMIT layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    QVector<int> newRows(m_entries.count());
+    QVector<DirectoryEntry> entries;
+    entries.reserve(m_entries.count());
+    for (auto row : keptRows) {
+        newRows[row] = entries.count();
+        entries<<m_entries.at(row);
+    }
+    for (auto row : deletedRows) {
+        newRows[row] = entries.count();
+        entries<<m_entries.at(row);
+    }
+    m_entries = entries;
+
+    auto from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.count());
+    for (auto index : from) {
+        to<<this->index(newRows.at(index.row()), index.column());
+    }
+    changePersistentIndexList(from, to);
+    Q_EMIT layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+
+    removeRows(keptRows.count(), deletedRows.count());
+}
+
+void FileSystemModel::renameEntries(const QHash<QString, QString> &renamed)
+{
+    QHash<QString, QString> newNames; //old name -> new name
+    for (auto it = renamed.constBegin(); it != renamed.constEnd(); it++) {
+        newNames.insert(it.value(), it.key());
+    }
+
+    QDir dir(m_rootPath);
+    QVector<int> rows;
+    for (int row = 0; row < m_entries.count(); row++) {
+        auto it = newNames.constFind(m_entries.at(row).name);
+        if (it == newNames.constEnd())
+            continue;
+
+        auto &entry = m_entries[row];
+        auto oldUri = entry.uri;
+        m_names.remove(entry.name);
+        entry.name = it.value();
+        entry.uri = DirectoryLoader::fileUri(dir.filePath(entry.name));
+        m_names<<entry.name;
+
+        // the image is the same, the cache of the new uri is filled by a new job.
+        m_thumbnailProvider.cancel(oldUri);
+        auto thumbnail = m_thumbnails.take(oldUri);
+        if (!thumbnail.isNull())
+            m_thumbnails.insert(entry.uri, thumbnail);
+        if (ThumbnailProvider::canThumbnail(entry.iconName))
+            m_thumbnailProvider.requestThumbnail(entry.uri, entry.modifiedTime);
+        rows<<row;
+    }
+    // view keeps the place and metainfo of a row whose uri changed.
+    emitRowsChanged(rows, {Qt::DisplayRole, Qt::UserRole});
+}
+
+void FileSystemModel::prioritizeThumbnails(const QStringList &uris)
+{
+    m_thumbnailProvider.prioritize(uris);
+}
+
+void FileSystemModel::onThumbnailReady(const QString &uri, const QImage &thumbnail)
+{
+    if (m_pendingThumbnails.isEmpty()) {
+        QTimer::singleShot(16, this, &FileSystemModel::applyThumbnails);
+    }
+    m_pendingThumbnails.insert(uri, thumbnail);
+}
+
+void FileSystemModel::applyThumbnails()
+{
+    // one pass over rows for all thumbnails finished in this frame.
+    for (int row = 0; row < m_entries.count() && !m_pendingThumbnails.isEmpty(); row++) {
+        const auto &uri = m_entries.at(row).uri;
+        auto it = m_pendingThumbnails.find(uri);
+        if (it == m_pendingThumbnails.end())
+            continue;
+
+        m_thumbnails.insert(uri, QIcon(QPixmap::fromImage(it.value())));
+        m_pendingThumbnails.erase(it);
+        auto changedIndex = index(row, 0);
+        Q_EMIT dataChanged(changedIndex, changedIndex, {Qt::DecorationRole});
+    }
+    // rows removed before thumbnails finished
+    m_pendingThumbnails.clear();
+}
+
+const QIcon &FileSystemModel::iconFromTheme(const QString &iconName) const
+{
+    // QIcon should be created in gui thread, so loader only gives the icon name.
+    if (m_iconThemeName != QIcon::themeName()) {
+        m_iconThemeName = QIcon::themeName();
+        m_icons.clear();
     }
-    if (role == Qt::UserRole) {
-        return "file://" + QStandardItemModel::data(index).toString();
-    } else {
-        return QStandardItemModel::data(index, role);
+    auto it = m_icons.constFind(iconName);
+    if (it == m_icons.constEnd()) {
+        auto icon = QIcon::fromTheme(iconName);
+        if (icon.isNull())
+            icon = QIcon::fromTheme("text-x-generic");
+        it = m_icons.insert(iconName, icon);
     }
+    return it.value();
 }
@@ -1,17 +1,75 @@
 #ifndef FILESYSTEMMODEL_H
 #define FILESYSTEMMODEL_H
 
-#include <QStandardItemModel>
+#include <QAbstractListModel>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QIcon>
 
-class FileSystemModel : public QStandardItemModel
+#include "directory-loader.h"
+#include "directory-watcher.h"
+#include "thumbnail-provider.h"
+
+class FileSystemModel : public QAbstractListModel
 {
     Q_OBJECT
 public:
     explicit FileSystemModel(QObject *parent = nullptr);
+    ~FileSystemModel() override;
+
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    bool isLoading() const;
+    qint64 firstBatchLatency() const; //msecs from setRootPath() to first rows inserted, -1 if not yet
+    qint64 loadTime() const; //msecs from setRootPath() to all rows inserted, -1 if not yet
 
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role) const override;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+
+public slots:
+    void prioritizeThumbnails(const QStringList &uris); //e.g. items visible on screens
 
 signals:
+    void firstBatchLoaded(qint64 msecs);
+    void loadFinished(qint64 msecs);
+
+private slots:
+    void onEntriesLoaded(int generation, const QVector<DirectoryEntry> &entries);
+    void onLoadFinished(int generation);
+    void onDirectoryChanged(const QStringList &created, const QStringList &deleted, const QStringList &modified, const QHash<QString, QString> &renamed);
+    void onThumbnailReady(const QString &uri, const QImage &thumbnail);
+    void applyThumbnails();
+
+private:
+    void removeEntries(const QSet<QString> &names);
+    void renameEntries(const QHash<QString, QString> &renamed); //new name -> old name, new names are free
+    void updateEntries(const QHash<QString, DirectoryEntry> &entries); //name -> stated entry of existing rows
+    void emitRowsChanged(const QVector<int> &rows, const QVector<int> &roles); //ascending rows, one dataChanged() per range
+    const QIcon &iconFromTheme(const QString &iconName) const;
+
+    QString m_rootPath;
+    QVector<DirectoryEntry> m_entries;
+    QSet<QString> m_names; //file names of m_entries
+
+    // resolved once per icon name, dropped when icon theme changed.
+    mutable QHash<QString, QIcon> m_icons;
+    mutable QString m_iconThemeName;
+
+    QThread m_loaderThread;
+    DirectoryLoader *m_loader = nullptr;
+    int m_generation = 0;
+    bool m_loading = false;
+
+    DirectoryWatcher m_watcher;
+
+    ThumbnailProvider m_thumbnailProvider;
+    QHash<QString, QIcon> m_thumbnails; //uri -> thumbnail
+    QHash<QString, QImage> m_pendingThumbnails; //applied to rows once per frame
 
+    QElapsedTimer m_loadTimer;
+    qint64 m_firstBatchLatency = -1;
+    qint64 m_loadTime = -1;
 };
 #endif // FILESYSTEMMODEL_H
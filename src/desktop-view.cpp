@@ -1,4 +1,5 @@
 #include "desktop-view.h"
+#include "trace.h"
 #include <QRect>
 #include "private/qabstractitemview_p.h"
 #include <QtWidgets/private/qtwidgetsglobal_p.h>
@@ -8,9 +9,12 @@
 #include <QPainter>
 
 #include <QDropEvent>
+#include <QStandardPaths>
 
 #include <QDebug>
 
+#include <algorithm>
+
 #define SCREEN_ID 1000
 #define RELATED_GRID_POSITION 1001
 
@@ -27,6 +31,9 @@ DesktopView::DesktopView(QWidget *parent) : QAbstractItemView(parent)
 
     // init grid size
     setIconSize(QSize(64, 64));
+    connect(this, &QAbstractItemView::iconSizeChanged, this, [=](){
+        m_iconPixmapCache.clear();
+    });
 
     setWindowFlag(Qt::FramelessWindowHint);
 
@@ -36,11 +43,13 @@ DesktopView::DesktopView(QWidget *parent) : QAbstractItemView(parent)
         auto screen = new Screen(qscreen, m_gridSize, this);
         addScreen(screen);
     }
+
+    setPositionStorePath(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/item-positions");
 }
 
 Screen *DesktopView::getScreen(int screenId)
 {
-    if (m_screens.count() > screenId) {
+    if (screenId >= 0 && m_screens.count() > screenId) {
         return m_screens.at(screenId);
     } else {
         return nullptr;
@@ -54,6 +63,9 @@ void DesktopView::addScreen(Screen *screen)
             removeScreen(screen);
         }
     });
+    screen->m_id = m_layout.addScreen(screen->m_pendingScreenGeometry, screen->m_pendingPanelMargins, screen->m_pendingGridSize);
+    screen->m_layout = &m_layout;
+    m_layout.setScreenValid(screen->m_id, screen->isValidScreen());
     m_screens<<screen;
 }
 
@@ -77,8 +89,12 @@ void DesktopView::swapScreen(Screen *screen1, Screen *screen2)
     m_screens.replace(index1, screen2);
     m_screens.replace(index2, screen1);
 
-    this->handleScreenChanged(screen1);
-    this->handleScreenChanged(screen2);
+    // screen id is the index in list, items and metainfo stay with their Screen.
+    screen1->m_id = index2;
+    screen2->m_id = index1;
+    m_layout.swapScreens(index1, index2);
+
+    // rebindScreen() already scheduled both screens
 }
 
 void DesktopView::removeScreen(Screen *screen)
@@ -88,62 +104,115 @@ void DesktopView::removeScreen(Screen *screen)
         return;
     }
 
-    this->handleScreenChanged(screen);
+    scheduleScreenLayout(screen);
 }
 
 void DesktopView::setGridSize(QSize size)
 {
     m_gridSize = size;
-    for (auto screen : m_screens) {
-        screen->onScreenGridSizeChanged(size);
+    m_labelLayoutCache.clear();
+    handleGridSizeChanged();
+    Q_EMIT gridSizeChanged(size);
+}
+
+void DesktopView::scheduleScreenLayout(Screen *screen)
+{
+    m_pendingLayoutRequestsCount++;
+    if (!m_pendingLayoutScreens.contains(screen))
+        m_pendingLayoutScreens<<screen;
+
+    if (!m_layoutScheduled) {
+        m_layoutScheduled = true;
+        QMetaObject::invokeMethod(this, "flushPendingLayout", Qt::QueuedConnection);
     }
+}
 
-    for (auto screen : m_screens) {
-        //越界图标重排
-        handleScreenChanged(screen);
+void DesktopView::flushPendingLayout()
+{
+    TRACE_SCOPE("hotplug");
+    m_layoutScheduled = false;
+    if (m_pendingLayoutScreens.isEmpty())
+        return;
+
+    auto screens = m_pendingLayoutScreens;
+    m_pendingLayoutScreens.clear();
+    // only requests this flush really merged are counted as saved.
+    m_savedRelayoutsCount += m_pendingLayoutRequestsCount - screens.count();
+    m_pendingLayoutRequestsCount = 0;
+
+    // 一次事务：先重算所有网格，再统一放置图标，最后只刷新一次
+    for (auto screen : screens) {
+        screen->applyPendingLayout();
+    }
+    handleScreensChanged(screens);
+    Q_EMIT layoutFlushed();
+}
+
+void DesktopView::setPositionStorePath(const QString &path)
+{
+    if (m_positionStore) {
+        delete m_positionStore;
+    }
+    m_positionStore = new ItemPositionStore(path, this);
+
+    // metainfo of the former store must not leak into the new one, items are placed again.
+    m_layout.clearMetaPoses();
+    loadItemsPositions();
+    if (model()) {
+        reset();
+    }
+}
+
+void DesktopView::setSelectionModel(QItemSelectionModel *selectionModel)
+{
+    QAbstractItemView::setSelectionModel(selectionModel);
+    rebuildSelectedItems();
+}
+
+void DesktopView::reset()
+{
+    QAbstractItemView::reset();
+
+    // lay out all rows of model again, only metainfo is kept.
+    m_layout.resetItems();
+    m_labelLayoutCache.clear();
+    if (model() && model()->rowCount() > 0) {
+        rowsInserted(QModelIndex(), 0, model()->rowCount() - 1);
     }
+
+    rebuildSelectedItems();
+    viewport()->update();
 }
 
 QRect DesktopView::visualRect(const QModelIndex &index) const
 {
-    auto rect = QRect(0, 0, m_gridSize.width(), m_gridSize.height());
-    // FIXME: uri
-    auto uri = getIndexUri(index);
-    auto pos = m_itemsPosesCached.value(uri);
-    rect.translate(pos);
+    // sized by the grid the item is placed on, a new grid size applies with the next layout transaction.
+    auto rect = QRect(QPoint(0, 0), m_gridSize);
+    auto id = findItemId(index);
+    if (id != INVALID_ITEM_ID) {
+        const auto &record = m_layout.items().record(id);
+        if (record.screenId >= 0)
+            rect.setSize(m_layout.screen(record.screenId).gridSize);
+        if (record.testFlag(ItemRecord::CachedPos))
+            rect.translate(record.cachedPos);
+    }
     return rect.adjusted(ICONVIEW_PADDING, ICONVIEW_PADDING, -ICONVIEW_PADDING, -ICONVIEW_PADDING);
 }
 
 QModelIndex DesktopView::indexAt(const QPoint &point) const
 {
-    QList<QRect> visualRects;
-    for (int row = 0; row < model()->rowCount(); row++) {
-        auto index = model()->index(row, 0);
-        visualRects<<visualRect(index);
-    }
-    for (auto rect : visualRects) {
-        if (rect.contains(point)) {
-            int row = visualRects.indexOf(rect);
-            return model()->index(row, 0);
-        }
-    }
-    return QModelIndex();
+    auto id = m_layout.itemAtGlobalPosition(point, ICONVIEW_PADDING);
+    if (id == INVALID_ITEM_ID)
+        return QModelIndex();
+    return m_layout.items().record(id).index;
 }
 
 QModelIndex DesktopView::findIndexByUri(const QString &uri) const
 {
-    if (model()) {
-        for (int row = 0; row < model()->rowCount(); row++) {
-            //FIXME:
-            auto index = model()->index(row, 0);
-            auto indexUri = getIndexUri(index);
-            if (indexUri == uri) {
-                return index;
-            }
-        }
-    }
-
-    return QModelIndex();
+    auto id = m_layout.items().id(uri);
+    if (id == INVALID_ITEM_ID)
+        return QModelIndex();
+    return m_layout.items().record(id).index;
 }
 
 QString DesktopView::getIndexUri(const QModelIndex &index) const
@@ -153,24 +222,33 @@ QString DesktopView::getIndexUri(const QModelIndex &index) const
 
 bool DesktopView::trySetIndexToPos(const QModelIndex &index, const QPoint &pos)
 {
-    for (auto screen : m_screens) {
-        if (!screen->isValidScreen()) {
-            continue;
-        }
-        if (screen->setItemWithGlobalPos(getIndexUri(index), pos)) {
-            //清空其它屏幕关于此index的gridPos?
-            for (auto screen : m_screens) {
-                screen->makeItemGridPosInvalid(getIndexUri(index));
-            }
-            //效率？
-            screen->setItemWithGlobalPos(getIndexUri(index), pos);
-            m_itemsPosesCached.insert(getIndexUri(index), screen->getItemGlobalPosition(getIndexUri(index)));
-            return true;
-        } else {
-            //不改变位置
-        }
+    auto id = findItemId(index);
+    if (id == INVALID_ITEM_ID || !m_layout.moveItem(id, pos))
+        return false;
+    Q_EMIT itemMovedTo(m_layout.items().uri(id), pos);
+    return true;
+}
+
+void DesktopView::moveItems(const QStringList &uris, const QPoint &offset)
+{
+    //计算全体偏移量，验证越界和重叠图标，重新排序
+    TRACE_SCOPE("drop");
+    QVector<ItemId> ids;
+    for (auto uri : uris) {
+        auto id = m_layout.items().id(uri);
+        if (id != INVALID_ITEM_ID && m_layout.items().record(id).testFlag(ItemRecord::InModel))
+            ids<<id;
+    }
+
+    // 排列失败的元素被列为浮动元素
+    auto moved = m_layout.dropItems(ids, offset);
+    for (auto id : moved) {
+        const auto &record = m_layout.items().record(id);
+        setItemPosMetaInfo(id, record.metaPos, record.metaScreenId);
     }
-    return false;
+
+    Q_EMIT itemsMoved(uris, offset);
+    viewport()->update();
 }
 
 bool DesktopView::isIndexOverlapped(const QModelIndex &index)
@@ -180,23 +258,17 @@ bool DesktopView::isIndexOverlapped(const QModelIndex &index)
 
 bool DesktopView::isItemOverlapped(const QString &uri)
 {
-    auto itemPos = m_itemsPosesCached.value(uri);
-    QStringList overrlappedItems;
-    for (auto item : m_items) {
-        if (m_itemsPosesCached.value(item) == itemPos) {
-            overrlappedItems<<item;
-            if (overrlappedItems.count() > 2) {
-                break;
-            }
-        }
-    }
+    auto id = m_layout.items().id(uri);
+    return id != INVALID_ITEM_ID && m_layout.isItemOverlapped(id);
+}
 
-    overrlappedItems.removeOne(uri);
-    if (!overrlappedItems.isEmpty()) {
-        return true;
-    } else {
-        return false;
+QStringList DesktopView::visibleItems()
+{
+    QStringList items;
+    for (auto id : m_layout.visibleItems()) {
+        items<<m_layout.items().uri(id);
     }
+    return items;
 }
 
 void DesktopView::_saveItemsPoses()
@@ -206,77 +278,69 @@ void DesktopView::_saveItemsPoses()
 
 void DesktopView::paintEvent(QPaintEvent *event)
 {
-    qDebug()<<"paint evnet";
+    TRACE_SCOPE("paint");
     QPainter p(viewport());
-    if (!event->rect().isEmpty()) {
-        // update one index only, used for dataChanged
-    } else {
-        // update all indexes, fixme: more effective?
-    }
+    // only paint the cells intersected with damage region, dataChanged() only damages one index.
+    const QRegion &region = event->region();
+    int itemsPainted = 0;
+    for (auto id : m_layout.itemsInGlobalRect(region.boundingRect())) {
+        if (!region.intersects(m_layout.itemGlobalRect(id)))
+            continue;
 
-    // test
-    for (auto item : m_items) {
-        auto index = findIndexByUri(item);
+        const auto &record = m_layout.items().record(id);
+        QModelIndex index = record.index;
         QStyleOptionViewItem opt = viewOptions();
-        opt.text = index.data().toString();
-        opt.icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
         opt.rect = visualRect(index);
         opt.state |= QStyle::State_Enabled;
-        if (selectedIndexes().contains(index)) {
+        bool selected = record.testFlag(ItemRecord::Selected);
+        if (selected) {
             opt.state |= QStyle::State_Selected;
         }
+        // style only lays out the decoration, icon and label are drawn from caches.
         qApp->style()->drawControl(QStyle::CE_ItemViewItem, &opt, &p, this);
+
+        auto icon = qvariant_cast<QIcon>(index.data(Qt::DecorationRole));
+        auto pixmap = m_iconPixmapCache.pixmap(icon, iconSize(), selected? QIcon::Selected: QIcon::Normal, devicePixelRatioF());
+        auto decorationRect = qApp->style()->subElementRect(QStyle::SE_ItemViewItemDecoration, &opt, this);
+        auto pixmapRect = QStyle::alignedRect(layoutDirection(), Qt::AlignCenter, pixmap.size() / pixmap.devicePixelRatio(), decorationRect);
+        p.drawPixmap(pixmapRect, pixmap);
+
+        int textMargin = qApp->style()->pixelMetric(QStyle::PM_FocusFrameHMargin, &opt, this) + 1;
+        auto textRect = opt.rect.adjusted(textMargin, 0, -textMargin, 0);
+        textRect.setTop(decorationRect.bottom() + 1);
+        const auto &label = m_labelLayoutCache.layout(record.uri, index.data().toString(), opt.font, textRect.size());
+        if (selected) {
+            p.fillRect(label.boundingRect.translated(textRect.topLeft()), palette().highlight());
+        }
+        p.setPen(palette().color(selected? QPalette::HighlightedText: QPalette::Text));
+        m_labelLayoutCache.draw(&p, textRect.topLeft(), label);
+        itemsPainted++;
+    }
+
+    m_paintedItemsCount = itemsPainted;
+    TRACE_COUNTER("items painted", itemsPainted);
+}
+
+void DesktopView::changeEvent(QEvent *event)
+{
+    QAbstractItemView::changeEvent(event);
+    if (event->type() == QEvent::StyleChange || event->type() == QEvent::ThemeChange) {
+        m_iconPixmapCache.clear();
+    }
+    if (event->type() == QEvent::StyleChange || event->type() == QEvent::FontChange) {
+        m_labelLayoutCache.clear();
     }
 }
 
 void DesktopView::dropEvent(QDropEvent *event)
 {
     // 有bug
-    //计算全体偏移量，验证越界和重叠图标，重新排序
     if (event->source() == this) {
-        QPoint offset = event->pos() - m_dragStartPos;
-        QHash<QModelIndex, QPoint> indexesPoses;
-        auto indexes = selectedIndexes();
-        QStringList itemsNeedBeRelayouted;
-        for (auto index : indexes) {
-            //清空屏幕关于此index的gridPos
-            for (auto screen : m_screens) {
-                screen->makeItemGridPosInvalid(getIndexUri(index));
-            }
-        }
-
-        for (auto index : indexes) {
-            bool successed = false;
-            auto sourceRect = visualRect(index);
-            sourceRect.adjust(-ICONVIEW_PADDING, -ICONVIEW_PADDING, ICONVIEW_PADDING, ICONVIEW_PADDING);
-            sourceRect.translate(offset);
-            indexesPoses.insert(index, sourceRect.center());
-
-            for (auto screen : m_screens) {
-                if (!screen->isValidScreen()) {
-                    continue;
-                }
-                if (screen->setItemWithGlobalPos(getIndexUri(index), sourceRect.center())) {
-                    successed = true;
-
-                    //效率？
-                    screen->setItemWithGlobalPos(getIndexUri(index), sourceRect.center());
-                    screen->setItemMetaInfoGridPos(getIndexUri(index), screen->itemGridPos(getIndexUri(index)));
-                    setItemPosMetaInfo(getIndexUri(index), screen->itemGridPos(getIndexUri(index)), m_screens.indexOf(screen));
-                    //覆盖原有index的位置
-                    m_itemsPosesCached.insert(getIndexUri(index), screen->getItemGlobalPosition(getIndexUri(index)));
-
-                    //TODO: 设置metainfo的位置
-                } else {
-                    //不改变位置
-                }
-            }
-            if (!successed) {
-                //排列失败，这个元素被列为浮动元素
-                itemsNeedBeRelayouted<<getIndexUri(index);
-            }
+        QStringList uris;
+        for (auto index : selectedIndexes()) {
+            uris<<getIndexUri(index);
         }
-        relayoutItems(itemsNeedBeRelayouted);
+        moveItems(uris, event->pos() - m_dragStartPos);
     } else {
 
     }
@@ -293,7 +357,6 @@ void DesktopView::mousePressEvent(QMouseEvent *event)
 {
     QAbstractItemView::mousePressEvent(event);
     m_dragStartPos = event->pos();
-    qDebug()<<m_dragStartPos;
 }
 
 void DesktopView::mouseMoveEvent(QMouseEvent *event)
@@ -333,18 +396,30 @@ QStyleOptionViewItem DesktopView::viewOptions() const
 
 void DesktopView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command)
 {
-    qDebug()<<"set selection";
+    TRACE_SCOPE("selection");
     // FIXME:
     if (m_rubberBand->isVisible()) {
-        for (int row = 0; row < model()->rowCount(); row++) {
-            auto index = model()->index(row, 0);
-            auto indexRect = visualRect(index);
-            if (rect.intersects(indexRect)) {
-                selectionModel()->select(index, QItemSelectionModel::Select);
-            } else {
-                selectionModel()->select(index, QItemSelectionModel::Deselect);
+        // only look at the cells under rubber band, and apply them in one selection.
+        QVector<int> rows;
+        for (auto id : m_layout.itemsInGlobalRect(rect, ICONVIEW_PADDING)) {
+            const auto &index = m_layout.items().record(id).index;
+            if (index.isValid())
+                rows<<index.row();
+        }
+
+        // consecutive rows are merged into one range, selection model compares ranges in quadratic time.
+        std::sort(rows.begin(), rows.end());
+        QItemSelection selection;
+        for (int i = 0; i < rows.count();) {
+            int first = rows.at(i);
+            int last = first;
+            for (i++; i < rows.count() && rows.at(i) <= last + 1; i++) {
+                last = rows.at(i);
             }
+            selection.select(model()->index(first, 0, rootIndex()), model()->index(last, 0, rootIndex()));
         }
+        // selection model only emits the difference from current selection.
+        selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
     } else {
         auto index = indexAt(rect.topLeft());
         selectionModel()->select(index, command);
@@ -362,101 +437,159 @@ QRegion DesktopView::visualRegionForSelection(const QItemSelection &selection) c
     return visualRegion;
 }
 
-void DesktopView::setItemPosMetaInfo(const QString &uri, const QPoint &gridPos, int screenId)
+void DesktopView::setItemPosMetaInfo(ItemId id, const QPoint &gridPos, int screenId)
 {
-    // FIXME:
+    // written behind, a batch of changes costs one write.
+    m_positionStore->setPosition(m_layout.items().uri(id), screenId, gridPos);
 }
 
 void DesktopView::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
 {
     auto string = topLeft.data().toString();
     Q_UNUSED(bottomRight)
-    Q_UNUSED(roles)
-    auto demageRect = visualRect(topLeft);
-    viewport()->update(demageRect);
+    if (roles.isEmpty() || roles.contains(Qt::UserRole)) {
+        // uri changed, find the records of changed rows in one pass over the table.
+        QMap<int, ItemId> renamedIds; //row -> record, in row order
+        for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+            auto id = m_layout.items().id(getIndexUri(model()->index(row, 0)));
+            if (id == INVALID_ITEM_ID || !m_layout.items().record(id).testFlag(ItemRecord::InModel))
+                renamedIds.insert(row, INVALID_ITEM_ID);
+        }
+        if (!renamedIds.isEmpty()) {
+            m_layout.items().forEach([&](ItemId id, ItemRecord &record) {
+                if (record.testFlag(ItemRecord::InModel) && record.index.parent() == topLeft.parent() && renamedIds.contains(record.index.row()))
+                    renamedIds[record.index.row()] = id;
+            });
+        }
+
+        for (auto it = renamedIds.constBegin(); it != renamedIds.constEnd(); it++) {
+            auto renamedId = it.value();
+            if (renamedId == INVALID_ITEM_ID)
+                continue;
+
+            // the renamed file keeps its place, selection and metainfo,
+            // a stale stored position of the new uri is dropped.
+            auto uri = getIndexUri(model()->index(it.key(), 0));
+            auto oldUri = m_layout.items().uri(renamedId);
+            m_labelLayoutCache.invalidate(oldUri);
+            auto id = m_layout.items().id(uri);
+            if (id != INVALID_ITEM_ID) {
+                m_layout.items().release(id);
+            }
+            m_layout.items().rename(renamedId, uri);
+            const auto &record = m_layout.items().record(renamedId);
+            m_positionStore->removePosition(oldUri);
+            if (record.hasMetaPos()) {
+                setItemPosMetaInfo(renamedId, record.metaPos, record.metaScreenId);
+            } else {
+                m_positionStore->removePosition(uri);
+            }
+        }
+    }
+
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole)) {
+        for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+            m_labelLayoutCache.invalidate(getIndexUri(model()->index(row, 0)));
+        }
+    }
+
+    QRegion demageRegion;
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        demageRegion += visualRect(model()->index(row, 0));
+    }
+    viewport()->update(demageRegion);
 }
 
 void DesktopView::rowsInserted(const QModelIndex &parent, int start, int end)
 {
+    Q_UNUSED(parent)
+    TRACE_SCOPE("model insert");
+    QVector<ItemId> ids;
+    ids.reserve(end - start + 1);
+    m_layout.items().reserve(m_layout.items().count() + end - start + 1);
     for (int i = start; i <= end ; i++) {
         auto index = model()->index(i, 0);
-        m_items.append(getIndexUri(index));
-        // FIXME: check if index has metainfo postion
-        if (false) {
-
-        } else {
-            // add index to float items.
-            m_floatItems<<getIndexUri(index);
-            for (auto screen : m_screens) {
-                // fixme: improve layout speed with cached position
-                auto gridPos = screen->placeItem(getIndexUri(index));
-                if (gridPos.x() >= 0) {
-                    m_itemsPosesCached.insert(getIndexUri(index), screen->getItemGlobalPosition(getIndexUri(index)));
-                    break;
-                }
-            }
-        }
+        auto id = m_layout.items().intern(getIndexUri(index));
+        m_layout.items().record(id).index = index;
+        ids<<id;
     }
 
+    // items with a free metainfo postion are placed directly, float items give way to them.
+    m_layout.insertItems(ids);
+
     viewport()->update();
+    Q_EMIT visibleItemsChanged();
 }
 
 void DesktopView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
 {
-    Q_UNUSED(end)
-    auto indexAboutToBeRemoved = model()->index(start, 0);
-
-    m_itemsPosesCached.remove(getIndexUri(indexAboutToBeRemoved));
-    m_items.removeOne(getIndexUri(indexAboutToBeRemoved));
-    m_floatItems.removeOne(getIndexUri(indexAboutToBeRemoved));
-    for (auto screen : m_screens) {
-        screen->makeItemGridPosInvalid(getIndexUri(indexAboutToBeRemoved));
+    // remove the whole range, float items fill the holes they leave.
+    TRACE_SCOPE("model remove");
+    QVector<ItemId> ids;
+    for (int row = start; row <= end; row++) {
+        auto uri = getIndexUri(model()->index(row, 0, parent));
+        auto id = m_layout.items().id(uri);
+        if (id == INVALID_ITEM_ID)
+            continue;
+        m_labelLayoutCache.invalidate(uri);
+        // a removed row is a deleted file, renamed files keep their rows.
+        // its position must not be inherited by a new file of the same name.
+        auto &record = m_layout.items().record(id);
+        record.metaScreenId = -1;
+        record.metaPos = INVALID_POS;
+        m_positionStore->removePosition(uri);
+        ids<<id;
     }
-
-    // 重排浮动元素
-    relayoutItems(m_floatItems);
+    m_layout.removeItems(ids);
 
     viewport()->update();
 }
 
-void DesktopView::saveItemsPositions()
+void DesktopView::selectionChanged(const QItemSelection &selected, const QItemSelection &deselected)
 {
-    //非越界元素的确认，越界元素不应该保存位置
-    QStringList itemOnAllScreen;
-    for (auto screen : m_screens) {
-        itemOnAllScreen<<screen->getItemsVisibleOnScreen();
-    }
-
-    for (auto item : itemOnAllScreen) {
-        //检查当前位置是否有重叠，如果有，则不确认
-        bool isOverlapped = isItemOverlapped(item);
-        if (!isOverlapped) {
-            //从浮动元素中排除
-            m_floatItems.removeOne(item);
-            //设置metainfo
-            auto screen = getItemScreen(item);
-            if (screen) {
-                int screenId = m_screens.indexOf(screen, 0);
-                QPoint gridPos = screen->itemGridPos(item);
-                screen->setItemMetaInfoGridPos(item, gridPos);
-                setItemPosMetaInfo(item, gridPos, screenId);
-            }
+    for (auto range : deselected) {
+        for (int row = range.top(); row <= range.bottom(); row++) {
+            auto id = findItemId(model()->index(row, 0, range.parent()));
+            if (id != INVALID_ITEM_ID)
+                m_layout.items().record(id).setFlag(ItemRecord::Selected, false);
+        }
+    }
+    for (auto range : selected) {
+        for (int row = range.top(); row <= range.bottom(); row++) {
+            auto id = findItemId(model()->index(row, 0, range.parent()));
+            if (id != INVALID_ITEM_ID)
+                m_layout.items().record(id).setFlag(ItemRecord::Selected);
         }
     }
+
+    QAbstractItemView::selectionChanged(selected, deselected);
+}
+
+void DesktopView::saveItemsPositions()
+{
+    //非越界、不重叠元素的确认
+    for (auto id : m_layout.confirmPositions()) {
+        const auto &record = m_layout.items().record(id);
+        setItemPosMetaInfo(id, record.metaPos, record.metaScreenId);
+    }
+    Q_EMIT itemsPositionsSaved();
 }
 
 void DesktopView::handleScreenChanged(Screen *screen)
 {
-    QStringList itemsNeedBeRelayouted = screen->getAllItemsOnScreen();
-    // 优先排列界内的有metainfo的图标
-    auto itemsMetaGridPosOnScreen = screen->getItemMetaGridPosVisibleOnScreen();
-    for (auto uri : itemsMetaGridPosOnScreen) {
-        itemsNeedBeRelayouted.removeOne(uri);
-        auto gridPos = screen->getItemMetaInfoGridPos(uri);
-        m_itemsPosesCached.insert(uri, screen->globalPositionFromGridPos(gridPos));
+    handleScreensChanged(QList<Screen *>()<<screen);
+}
+
+void DesktopView::handleScreensChanged(const QList<Screen *> &screens)
+{
+    // 优先排列界内的有metainfo的图标，其余的重新排列
+    TRACE_SCOPE("relayout screens");
+    QVector<int> screenIds;
+    for (auto screen : screens) {
+        screenIds<<screen->screenId();
     }
-    // sort?
-    relayoutItems(itemsNeedBeRelayouted);
+    m_layout.relayoutScreens(screenIds);
+    Q_EMIT visibleItemsChanged();
 
 //    if (!screen->isValidScreen()) {
 //        // 对越界图标进行重排，但是不记录位置
@@ -481,54 +614,86 @@ void DesktopView::handleScreenChanged(Screen *screen)
 
 void DesktopView::handleGridSizeChanged()
 {
-    // 保持index相对的grid位置不变，对越界图标进行处理
+    // 保持index相对的grid位置不变，越界图标在下一次布局事务中重排
     for (auto screen : m_screens) {
         screen->onScreenGridSizeChanged(m_gridSize);
-        // 更新屏幕内图标的位置
+    }
+}
 
-        // 记录越界图标
-        handleScreenChanged(screen);
+void DesktopView::prunePositions()
+{
+    // uris without a row, e.g. files deleted while the desktop was not running.
+    QStringList staleUris;
+    for (auto it = m_positionStore->positions().constBegin(); it != m_positionStore->positions().constEnd(); it++) {
+        auto id = m_layout.items().id(it.key());
+        if (id == INVALID_ITEM_ID || !m_layout.items().record(id).testFlag(ItemRecord::InModel))
+            staleUris<<it.key();
+    }
+    for (auto uri : staleUris) {
+        m_positionStore->removePosition(uri);
     }
-    // 重排越界图标
 
-    viewport()->update();
+    QVector<ItemId> staleItems;
+    m_layout.items().forEach([&](ItemId id, const ItemRecord &record) {
+        if (!record.testFlag(ItemRecord::InModel))
+            staleItems<<id;
+    });
+    for (auto id : staleItems) {
+        m_layout.items().release(id);
+    }
 }
 
-void DesktopView::relayoutItems(const QStringList &uris)
+void DesktopView::relayoutItems(const QVector<ItemId> &ids)
 {
-    for (auto uri : uris) {
-        for (auto screen : m_screens) {
-            screen->makeItemGridPosInvalid(uri);
-        }
-    }
+    // items could not be placed on any screen are kept out of grid.
+    TRACE_SCOPE("relayout");
+    m_layout.relayoutItems(ids);
+}
 
+void DesktopView::loadItemsPositions()
+{
+    // 读取保存的位置，作为各屏幕的metainfo
+    m_positionStore->load();
+    const auto &positions = m_positionStore->positions();
+    m_layout.items().reserve(positions.count());
+    // interned in uri order, ids must not depend on hash seed.
+    auto uris = positions.keys();
+    std::sort(uris.begin(), uris.end());
     for (auto uri : uris) {
-        for (auto screen : m_screens) {
-            QPoint currentGridPos = QPoint();
-            // fixme: improve layout speed with cached position
-            currentGridPos = screen->placeItem(uri, currentGridPos);
-            if (currentGridPos != INVALID_POS) {
-                m_itemsPosesCached.insert(uri, screen->getItemGlobalPosition(uri));
-                break;
-            } else {
-                // FIXME:
-                // no place to place items
-                m_itemsPosesCached.remove(uri);
-            }
+        const auto &position = positions[uri];
+        auto screen = getScreen(position.screenId);
+        if (screen) {
+            screen->setItemMetaInfoGridPos(m_layout.items().intern(uri), position.gridPos);
         }
     }
 }
 
-Screen *DesktopView::getItemScreen(const QString &uri)
+void DesktopView::rebuildSelectedItems()
 {
-    auto itemPos = m_itemsPosesCached.value(uri);
-    for (auto screen : m_screens) {
-        if (screen->isValidScreen()) {
-            if (screen->getGeometry().contains(itemPos))
-                return screen;
+    m_layout.items().forEach([](ItemId, ItemRecord &record) {
+        record.setFlag(ItemRecord::Selected, false);
+    });
+    if (!model() || !selectionModel())
+        return;
+
+    for (auto range : selectionModel()->selection()) {
+        for (int row = range.top(); row <= range.bottom(); row++) {
+            auto id = findItemId(model()->index(row, 0, range.parent()));
+            if (id != INVALID_ITEM_ID)
+                m_layout.items().record(id).setFlag(ItemRecord::Selected);
         }
     }
+}
 
-    // should not happend
-    return nullptr;
+Screen *DesktopView::getItemScreen(ItemId id)
+{
+    // recorded by Screen when the item is placed or invalidated.
+    return getScreen(m_layout.items().record(id).screenId);
+}
+
+ItemId DesktopView::findItemId(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return INVALID_ITEM_ID;
+    return m_layout.items().id(getIndexUri(index));
 }
@@ -2,7 +2,12 @@
 #define DESKTOPVIEW_H
 
 #include "screen.h"
+#include "icon-pixmap-cache.h"
+#include "label-layout-cache.h"
+#include "item-position-store.h"
+#include "layout-engine.h"
 #include <QAbstractItemView>
+#include <QSet>
 
 class DesktopViewPrivate;
 
@@ -20,6 +25,10 @@ public:
     void removeScreen(Screen *screen);
 
     void setGridSize(QSize size);
+    QSize gridSize() const {return m_gridSize;} //requested size, screens apply it in the next layout transaction
+    void setPositionStorePath(const QString &path);
+
+    void setSelectionModel(QItemSelectionModel *selectionModel) override;
 
     QRect visualRect(const QModelIndex &index) const override;
     QModelIndex indexAt(const QPoint &point) const override;
@@ -27,15 +36,23 @@ public:
     QString getIndexUri(const QModelIndex &index) const;
 
     bool trySetIndexToPos(const QModelIndex &index, const QPoint &pos);
+    void moveItems(const QStringList &uris, const QPoint &offset); //drop items by offset, 可能改变metainfo
     bool isIndexOverlapped(const QModelIndex &index);
     bool isItemOverlapped(const QString &uri);
 
+    QStringList visibleItems(); //items visible on all screens
+
     void scrollTo(const QModelIndex &index, ScrollHint hint) override {}
 
     void _saveItemsPoses(); //测试用
+    int paintedItemsCount() const {return m_paintedItemsCount;} //上次paintEvent绘制的元素数量
+    int savedRelayoutsCount() const {return m_savedRelayoutsCount;} //已执行的布局事务合并掉的屏幕重排次数
+    const LayoutEngine &layoutEngine() const {return m_layout;}
+    const IconPixmapCache &iconPixmapCache() const {return m_iconPixmapCache;}
 
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void changeEvent(QEvent *event) override;
     void dropEvent(QDropEvent *event) override; //可能改变metainfo
     void startDrag(Qt::DropActions supportedActions) override;
     void mousePressEvent(QMouseEvent *event) override;
@@ -50,34 +67,65 @@ protected:
     void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command) override;
     QRegion visualRegionForSelection(const QItemSelection &selection) const override;
 
-    void setItemPosMetaInfo(const QString &uri, const QPoint &gridPos, int screenId = 0);
+    void setItemPosMetaInfo(ItemId id, const QPoint &gridPos, int screenId = 0);
+
+signals:
+    void visibleItemsChanged(); //layout changed, e.g. used for prioritizing thumbnails of visible items
+    void gridSizeChanged(const QSize &size);
+    void itemsMoved(const QStringList &uris, const QPoint &offset);
+    void itemMovedTo(const QString &uri, const QPoint &pos); //by trySetIndexToPos()
+    void itemsPositionsSaved(); //not overlapped visible items confirmed their positions
+    void layoutFlushed(); //queued screen/grid changes were applied
+
+public slots:
+    void reset() override;
+    void flushPendingLayout(); //立即应用排队中的屏幕/网格变化
+    void prunePositions(); //forget stored positions of uris not in model, call when model is fully loaded
 
 protected slots:
     void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
                      const QVector<int> &roles = QVector<int>()) override;
     void rowsInserted(const QModelIndex &parent, int start, int end) override; //改变metainfo，浮动元素除外
     void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end) override;
+    void selectionChanged(const QItemSelection &selected, const QItemSelection &deselected) override;
 
     void saveItemsPositions();
 
     void handleScreenChanged(Screen *screen); //不改变metainfo
+    void handleScreensChanged(const QList<Screen *> &screens); //不改变metainfo
     void handleGridSizeChanged(); //不改变metainfo
 
-    void relayoutItems(const QStringList &uris);
+    void relayoutItems(const QVector<ItemId> &ids);
 
-    Screen *getItemScreen(const QString &uri);
+    Screen *getItemScreen(ItemId id);
+
+private:
+    ItemId findItemId(const QModelIndex &index) const;
+    void rebuildSelectedItems();
+    void scheduleScreenLayout(Screen *screen);
+    void loadItemsPositions();
 
 private:
     QSize m_gridSize = QSize(100, 150);
     QList <Screen *> m_screens;
 
-    QStringList m_items; //uris
-    QStringList m_floatItems; //当有拖拽或者libpeony文件操作触发时，固定所有float元素并记录metaInfo
-    QMap<QString, QPoint> m_itemsPosesCached;
+    // 所有元素的布局状态和各屏幕的网格，Screen只是QScreen到其中一个屏幕的绑定。
+    LayoutEngine m_layout;
 
     QPoint m_dragStartPos;
 
+    int m_paintedItemsCount = 0;
+
+    QList<Screen *> m_pendingLayoutScreens;
+    bool m_layoutScheduled = false;
+    int m_pendingLayoutRequestsCount = 0; //requests of m_pendingLayoutScreens
+    int m_savedRelayoutsCount = 0;
+    IconPixmapCache m_iconPixmapCache;
+    LabelLayoutCache m_labelLayoutCache;
+
     QRubberBand *m_rubberBand = nullptr;
+
+    ItemPositionStore *m_positionStore = nullptr;
 };
 
 #endif // DESKTOPVIEW_H
@@ -0,0 +1,492 @@
+#include "event-log.h"
+#include "desktop-view.h"
+#include "item-position-store.h"
+
+#include <QGuiApplication>
+#include <QDebug>
+
+#include <algorithm>
+
+#define LOG_MAGIC 0x4C455644 //"DVEL"
+#define LOG_VERSION 3
+
+EventRecorder::EventRecorder(DesktopView *view, const QString &path, QObject *parent) : QObject(parent), m_file(path)
+{
+    m_view = view;
+    m_model = view->model();
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning()<<"can not record events to"<<path;
+        return;
+    }
+    m_stream.setDevice(&m_file);
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+    m_stream.setVersion(QDataStream::Qt_5_0);
+    m_stream<<quint32(LOG_MAGIC)<<quint32(LOG_VERSION);
+    m_timer.start();
+
+    // current state first, grid size before screens so that one layout transaction applies both.
+    const auto &layout = view->layoutEngine();
+    beginEvent(EventLog::GridSize);
+    m_stream<<view->gridSize();
+
+    beginEvent(EventLog::Screens);
+    m_stream<<qint32(layout.screenCount());
+    for (int screenId = 0; screenId < layout.screenCount(); screenId++) {
+        m_stream<<layout.screen(screenId).geometry<<layout.screen(screenId).margins;
+    }
+
+    QVector<ItemId> positions;
+    layout.items().forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.hasMetaPos())
+            positions<<id;
+    });
+    beginEvent(EventLog::Positions);
+    m_stream<<qint32(positions.count());
+    for (auto id : positions) {
+        const auto &record = layout.items().record(id);
+        writeUri(record.uri);
+        m_stream<<qint32(record.metaScreenId)<<record.metaPos;
+    }
+
+    if (m_model && m_model->rowCount() > 0) {
+        recordRows(EventLog::RowsInserted, 0, m_model->rowCount());
+    }
+
+    if (m_model) {
+        connect(m_model, &QAbstractItemModel::rowsInserted, this, [=](const QModelIndex &parent, int first, int last){
+            if (!parent.isValid())
+                recordRows(EventLog::RowsInserted, first, last - first + 1);
+        });
+        // by uri, rows may have been permuted by a layout change before, e.g. scattered deletions.
+        connect(m_model, &QAbstractItemModel::rowsAboutToBeRemoved, this, [=](const QModelIndex &parent, int first, int last){
+            if (parent.isValid())
+                return;
+            beginEvent(EventLog::RowsRemoved);
+            m_stream<<qint32(last - first + 1);
+            for (int row = first; row <= last; row++) {
+                writeUri(m_model->index(row, 0).data(Qt::UserRole).toString());
+            }
+        });
+        connect(m_model, &QAbstractItemModel::dataChanged, this, [=](const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles){
+            if (topLeft.parent().isValid())
+                return;
+            if (roles.isEmpty() || roles.contains(Qt::UserRole) || roles.contains(Qt::DisplayRole))
+                recordRows(EventLog::RowsChanged, topLeft.row(), bottomRight.row() - topLeft.row() + 1);
+        });
+        connect(m_model, &QAbstractItemModel::modelReset, this, [=](){
+            beginEvent(EventLog::ModelReset);
+            if (m_model->rowCount() > 0)
+                recordRows(EventLog::RowsInserted, 0, m_model->rowCount());
+        });
+    }
+
+    for (int screenId = 0; screenId < layout.screenCount(); screenId++) {
+        auto screen = view->getScreen(screenId);
+        connect(screen, &Screen::geometryChanged, this, [=](const QRect &geometry){
+            beginEvent(EventLog::ScreenGeometry);
+            m_stream<<qint32(screen->screenId())<<geometry;
+        });
+        connect(screen, &Screen::panelMarginsChanged, this, [=](const QMargins &margins){
+            beginEvent(EventLog::PanelMargins);
+            m_stream<<qint32(screen->screenId())<<margins;
+        });
+        connect(screen, &Screen::screenVisibleChanged, this, [=](bool visible){
+            beginEvent(EventLog::ScreenValid);
+            m_stream<<qint32(screen->screenId())<<visible<<(screen->getScreen()? screen->getScreen()->geometry(): QRect());
+        });
+    }
+    connect(view, &DesktopView::gridSizeChanged, this, [=](const QSize &size){
+        beginEvent(EventLog::GridSize);
+        m_stream<<size;
+    });
+    connect(view, &DesktopView::layoutFlushed, this, [=](){
+        beginEvent(EventLog::LayoutFlushed);
+    });
+    connect(view, &DesktopView::itemMovedTo, this, [=](const QString &uri, const QPoint &pos){
+        beginEvent(EventLog::ItemMovedTo);
+        writeUri(uri);
+        m_stream<<pos;
+    });
+    connect(view, &DesktopView::itemsPositionsSaved, this, [=](){
+        beginEvent(EventLog::PositionsSaved);
+    });
+    connect(view, &DesktopView::itemsMoved, this, [=](const QStringList &uris, const QPoint &offset){
+        beginEvent(EventLog::Drop);
+        m_stream<<offset<<qint32(uris.count());
+        for (auto uri : uris) {
+            writeUri(uri);
+        }
+    });
+}
+
+EventRecorder::~EventRecorder()
+{
+    stop();
+}
+
+bool EventRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+void EventRecorder::stop()
+{
+    if (!isRecording())
+        return;
+
+    if (m_model)
+        m_model->disconnect(this);
+    if (m_view) {
+        m_view->disconnect(this);
+        for (int screenId = 0; screenId < m_view->layoutEngine().screenCount(); screenId++) {
+            m_view->getScreen(screenId)->disconnect(this);
+        }
+    }
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
+
+void EventRecorder::beginEvent(EventLog::Type type)
+{
+    m_stream<<quint8(type)<<qint64(m_timer.nsecsElapsed());
+    m_eventsCount++;
+}
+
+void EventRecorder::writeUri(const QString &uri)
+{
+    m_stream<<uri.toUtf8();
+}
+
+void EventRecorder::recordRows(EventLog::Type type, int row, int count)
+{
+    beginEvent(type);
+    m_stream<<qint32(row)<<qint32(count);
+    for (int i = row; i < row + count; i++) {
+        auto index = m_model->index(i, 0);
+        writeUri(index.data(Qt::UserRole).toString());
+        m_stream<<index.data().toString().toUtf8();
+    }
+}
+
+ReplayModel::ReplayModel(QObject *parent) : QAbstractListModel(parent)
+{
+    m_icon = QIcon::fromTheme("text-plain");
+}
+
+int ReplayModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid()? 0: m_entries.count();
+}
+
+QVariant ReplayModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_entries.count())
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return m_entries.at(index.row()).name;
+    case Qt::DecorationRole:
+        return m_icon;
+    case Qt::UserRole:
+        return m_entries.at(index.row()).uri;
+    default:
+        return QVariant();
+    }
+}
+
+void ReplayModel::insertEntries(int row, const QVector<Entry> &entries)
+{
+    if (entries.isEmpty())
+        return;
+    row = qBound(0, row, m_entries.count());
+    beginInsertRows(QModelIndex(), row, row + entries.count() - 1);
+    m_entries.insert(row, entries.count(), Entry());
+    std::copy(entries.begin(), entries.end(), m_entries.begin() + row);
+    endInsertRows();
+}
+
+bool ReplayModel::removeUris(const QStringList &uris)
+{
+    if (uris.isEmpty())
+        return true;
+
+    QHash<QString, int> rows;
+    for (int row = 0; row < m_entries.count(); row++) {
+        rows.insert(m_entries.at(row).uri, row);
+    }
+    QVector<int> removedRows;
+    QVector<bool> removed(m_entries.count(), false);
+    for (auto uri : uris) {
+        auto it = rows.constFind(uri);
+        if (it == rows.constEnd() || removed.at(it.value()))
+            return false;
+        removedRows<<it.value();
+        removed[it.value()] = true;
+    }
+
+    int first = m_entries.count() - removedRows.count();
+    bool inPlace = true;
+    for (int i = 1; i < removedRows.count(); i++) {
+        inPlace &= removedRows.at(i) == removedRows.at(i - 1) + 1;
+    }
+    if (inPlace) {
+        first = removedRows.first();
+    } else {
+        // the same layout change as the recorded model made, kept rows first, then removed rows in order.
+        Q_EMIT layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+        QVector<int> newRows(m_entries.count());
+        QVector<Entry> entries;
+        entries.reserve(m_entries.count());
+        for (int row = 0; row < m_entries.count(); row++) {
+            if (!removed.at(row)) {
+                newRows[row] = entries.count();
+                entries<<m_entries.at(row);
+            }
+        }
+        for (auto row : removedRows) {
+            newRows[row] = entries.count();
+            entries<<m_entries.at(row);
+        }
+        m_entries = entries;
+
+        auto from = persistentIndexList();
+        QModelIndexList to;
+        to.reserve(from.count());
+        for (auto index : from) {
+            to<<this->index(newRows.at(index.row()), index.column());
+        }
+        changePersistentIndexList(from, to);
+        Q_EMIT layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+    }
+
+    beginRemoveRows(QModelIndex(), first, first + removedRows.count() - 1);
+    m_entries.remove(first, removedRows.count());
+    endRemoveRows();
+    return true;
+}
+
+void ReplayModel::setEntries(int row, const QVector<Entry> &entries)
+{
+    if (entries.isEmpty() || row < 0 || row + entries.count() > m_entries.count())
+        return;
+    std::copy(entries.begin(), entries.end(), m_entries.begin() + row);
+    Q_EMIT dataChanged(index(row, 0), index(row + entries.count() - 1, 0), {Qt::DisplayRole, Qt::UserRole});
+}
+
+void ReplayModel::clear()
+{
+    beginResetModel();
+    m_entries.clear();
+    endResetModel();
+}
+
+EventReplayer::EventReplayer(DesktopView *view, ReplayModel *model)
+{
+    m_view = view;
+    m_model = model;
+    // no positions of the user's store before the recorded ones, and no rows yet.
+    m_view->setPositionStorePath(m_storeDir.filePath("item-positions"));
+    m_view->setModel(m_model);
+}
+
+bool EventReplayer::replay(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning()<<"can not open event log"<<path;
+        return false;
+    }
+
+    // read at once, replay is not bound by io.
+    QByteArray data = file.readAll();
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream>>magic>>version;
+    if (magic != LOG_MAGIC || version != LOG_VERSION) {
+        qWarning()<<"not an event log:"<<path;
+        return false;
+    }
+
+    m_stats.clear();
+    QElapsedTimer timer;
+    timer.start();
+    while (!stream.atEnd()) {
+        quint8 type = 0;
+        qint64 time = 0;
+        stream>>type>>time;
+
+        qint64 start = timer.nsecsElapsed();
+        if (!applyEvent(EventLog::Type(type), stream) || stream.status() != QDataStream::Ok) {
+            qWarning()<<"event log is broken at event"<<type<<"recorded at"<<time<<"ns";
+            m_elapsed = timer.nsecsElapsed();
+            return false;
+        }
+        qint64 cost = timer.nsecsElapsed() - start;
+
+        auto &stats = m_stats[EventLog::Type(type)];
+        stats.count++;
+        stats.totalNsecs += cost;
+        stats.maxNsecs = qMax(stats.maxNsecs, cost);
+    }
+    m_elapsed = timer.nsecsElapsed();
+    return true;
+}
+
+bool EventReplayer::applyEvent(EventLog::Type type, QDataStream &stream)
+{
+    switch (type) {
+    case EventLog::Screens: {
+        qint32 count = 0;
+        stream>>count;
+        for (int screenId = 0; screenId < count; screenId++) {
+            QRect geometry;
+            QMargins margins;
+            stream>>geometry>>margins;
+            // the replaying platform may have less screens, extra screens share the primary one.
+            auto screen = m_view->getScreen(screenId);
+            if (!screen) {
+                screen = new Screen(qApp->primaryScreen(), m_view->gridSize(), m_view);
+                m_view->addScreen(screen);
+            }
+            screen->onScreenGeometryChanged(geometry);
+            screen->setPanelMargins(margins);
+        }
+        m_view->flushPendingLayout();
+        return true;
+    }
+    case EventLog::GridSize: {
+        QSize size;
+        stream>>size;
+        m_view->setGridSize(size);
+        return true;
+    }
+    case EventLog::Positions: {
+        qint32 count = 0;
+        stream>>count;
+        ItemPositionStore store(m_storeDir.filePath("item-positions"));
+        for (int i = 0; i < count; i++) {
+            auto uri = readUri(stream);
+            qint32 screenId = -1;
+            QPoint gridPos;
+            stream>>screenId>>gridPos;
+            store.setPosition(uri, screenId, gridPos);
+        }
+        store.flush();
+        m_view->setPositionStorePath(store.path());
+        return true;
+    }
+    case EventLog::RowsInserted: {
+        qint32 row = 0;
+        qint32 count = 0;
+        stream>>row>>count;
+        // one rowsInserted() as recorded
+        m_model->insertEntries(row, readEntries(stream, count));
+        return true;
+    }
+    case EventLog::RowsRemoved: {
+        qint32 count = 0;
+        stream>>count;
+        QStringList uris;
+        for (int i = 0; i < count; i++) {
+            uris<<readUri(stream);
+        }
+        return m_model->removeUris(uris);
+    }
+    case EventLog::RowsChanged: {
+        qint32 row = 0;
+        qint32 count = 0;
+        stream>>row>>count;
+        m_model->setEntries(row, readEntries(stream, count));
+        return true;
+    }
+    case EventLog::ModelReset: {
+        m_model->clear();
+        return true;
+    }
+    case EventLog::ScreenGeometry: {
+        qint32 screenId = -1;
+        QRect geometry;
+        stream>>screenId>>geometry;
+        if (auto screen = m_view->getScreen(screenId))
+            screen->onScreenGeometryChanged(geometry);
+        return true;
+    }
+    case EventLog::LayoutFlushed: {
+        m_view->flushPendingLayout();
+        return true;
+    }
+    case EventLog::Drop: {
+        QPoint offset;
+        qint32 count = 0;
+        stream>>offset>>count;
+        QStringList uris;
+        for (int i = 0; i < count; i++) {
+            uris<<readUri(stream);
+        }
+        m_view->moveItems(uris, offset);
+        return true;
+    }
+    case EventLog::PanelMargins: {
+        qint32 screenId = -1;
+        QMargins margins;
+        stream>>screenId>>margins;
+        if (auto screen = m_view->getScreen(screenId))
+            screen->setPanelMargins(margins);
+        return true;
+    }
+    case EventLog::ItemMovedTo: {
+        auto uri = readUri(stream);
+        QPoint pos;
+        stream>>pos;
+        m_view->trySetIndexToPos(m_view->findIndexByUri(uri), pos);
+        return true;
+    }
+    case EventLog::PositionsSaved: {
+        m_view->_saveItemsPoses();
+        return true;
+    }
+    case EventLog::ScreenValid: {
+        qint32 screenId = -1;
+        bool valid = false;
+        QRect geometry;
+        stream>>screenId>>valid>>geometry;
+        auto screen = m_view->getScreen(screenId);
+        if (!screen)
+            return true;
+        if (!valid) {
+            screen->unbindScreen();
+        } else {
+            // the replaying platform has its own screens, only the geometry is recorded.
+            screen->rebindScreen(qApp->primaryScreen());
+            screen->onScreenGeometryChanged(geometry);
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+QString EventReplayer::readUri(QDataStream &stream)
+{
+    QByteArray uri;
+    stream>>uri;
+    return QString::fromUtf8(uri);
+}
+
+QVector<ReplayModel::Entry> EventReplayer::readEntries(QDataStream &stream, int count)
+{
+    QVector<ReplayModel::Entry> entries;
+    for (int i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        ReplayModel::Entry entry;
+        entry.uri = readUri(stream);
+        QByteArray name;
+        stream>>name;
+        entry.name = QString::fromUtf8(name);
+        entries<<entry;
+    }
+    return entries;
+}
@@ -0,0 +1,127 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <QObject>
+#include <QAbstractListModel>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QPointer>
+#include <QMap>
+#include <QIcon>
+
+class DesktopView;
+
+// binary log of what drives the layout of a view: model rows, screen geometries
+// and validity, grid size, layout transactions and drops. swapScreen() is not recorded.
+// file layout, little endian QDataStream:
+// header: magic, version
+// event: type (uint8), time since recording started (int64 ns), payload of type
+namespace EventLog {
+enum Type : quint8 {
+    GridSize = 1, //size. first event
+    Screens, //screen count, (geometry, panel margins)...
+    Positions, //stored positions count, (uri, screen id, grid pos)...
+    RowsInserted, //row, count, (uri, display name)...
+    RowsRemoved, //count, uri... removed as one block, in this order
+    ModelReset, //followed by RowsInserted of all rows
+    ScreenGeometry, //screen id, geometry
+    LayoutFlushed,
+    Drop, //offset, count, uri...
+    PanelMargins, //screen id, margins
+    ItemMovedTo, //uri, global pos
+    PositionsSaved,
+    ScreenValid, //screen id, valid, geometry. QScreen destroyed or rebound
+    RowsChanged //row, count, (uri, display name)... uri or name of rows changed, e.g. renamed
+};
+}
+
+// records a view and its model until stopped or destroyed.
+class EventRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EventRecorder(DesktopView *view, const QString &path, QObject *parent = nullptr);
+    ~EventRecorder() override;
+
+    bool isRecording() const;
+    int eventsCount() const {return m_eventsCount;}
+
+public slots:
+    void stop();
+
+private:
+    void beginEvent(EventLog::Type type);
+    void writeUri(const QString &uri);
+    void recordRows(EventLog::Type type, int row, int count);
+
+    QPointer<DesktopView> m_view;
+    QPointer<QAbstractItemModel> m_model;
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_timer;
+    int m_eventsCount = 0;
+};
+
+// flat model of a replay, rows are (uri, display name).
+// rows can be removed by uri in one block, as FileSystemModel removes scattered rows.
+class ReplayModel : public QAbstractListModel
+{
+public:
+    struct Entry
+    {
+        QString uri;
+        QString name;
+    };
+
+    explicit ReplayModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    void insertEntries(int row, const QVector<Entry> &entries);
+    bool removeUris(const QStringList &uris); //rows are moved to the end in this order first, if needed
+    void setEntries(int row, const QVector<Entry> &entries);
+    void clear();
+
+private:
+    QVector<Entry> m_entries;
+    QIcon m_icon;
+};
+
+// applies a recorded log to a view as fast as possible, layout transactions
+// are flushed where they were recorded, so that replay does not depend on event loop.
+// view starts from an empty position store, only the recorded positions are used.
+class EventReplayer
+{
+public:
+    struct Stats
+    {
+        int count = 0;
+        qint64 totalNsecs = 0;
+        qint64 maxNsecs = 0;
+    };
+
+    // view gets model, and a position store with the recorded positions.
+    explicit EventReplayer(DesktopView *view, ReplayModel *model);
+
+    bool replay(const QString &path);
+
+    qint64 elapsed() const {return m_elapsed;} //ns
+    const QMap<EventLog::Type, Stats> &stats() const {return m_stats;} //latency of each event type
+
+private:
+    bool applyEvent(EventLog::Type type, QDataStream &stream);
+    QString readUri(QDataStream &stream);
+    QVector<ReplayModel::Entry> readEntries(QDataStream &stream, int count);
+
+    DesktopView *m_view;
+    ReplayModel *m_model;
+    QTemporaryDir m_storeDir;
+
+    qint64 m_elapsed = 0;
+    QMap<EventLog::Type, Stats> m_stats;
+};
+
+#endif // EVENTLOG_H
@@ -7,11 +7,36 @@
 
 #include "desktop-view.h"
 #include "filesystem-model.h"
+#include "event-log.h"
+#include "test-fixtures.h"
 
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QStandardItemModel>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QEventLoop>
+#include <QRandomGenerator>
+#include <QDebug>
+
+// defined here, it needs malloc.h
+//#define TEST_ITEM_TABLE_MEMORY
+#ifdef TEST_ITEM_TABLE_MEMORY
+#include <malloc.h>
+#endif
+
+//#define TEST_RECORD_EVENTS
+//#define TEST_REPLAY_EVENTS
+// log file of both, or $DESKTOP_VIEW_EVENT_LOG
+#define EVENT_LOG_PATH "/tmp/desktop-view-events.log"
 
 int main(int argc, char *argv[])
 {
+#ifdef TEST_REPLAY_EVENTS
+    // 回放不需要真实的显示
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
     QApplication a(argc, argv);
 
     DesktopView v;
@@ -19,9 +44,11 @@ int main(int argc, char *argv[])
     v.setModel(&m);
     v.showMaximized();
 
-    for (int i = 0; i < 50; i++) {
-        m.appendRow(new QStandardItem(QIcon::fromTheme("folder"), QString::number(i)));
-    }
+    QObject::connect(&v, &DesktopView::visibleItemsChanged, &m, [&]{
+        m.prioritizeThumbnails(v.visibleItems());
+    });
+    QObject::connect(&m, &FileSystemModel::loadFinished, &v, &DesktopView::prunePositions);
+    m.setRootPath(QStandardPaths::writableLocation(QStandardPaths::DesktopLocation));
 
 //#define TEST_GEOMETRY_CHANGED
 #ifdef TEST_GEOMETRY_CHANGED
@@ -61,6 +88,323 @@ int main(int argc, char *argv[])
     });
 #endif
 
+//#define TEST_BULK_INSERT
+#ifdef TEST_BULK_INSERT
+    QTimer::singleShot(1000, [&]{
+        const int count = 5000;
+        QElapsedTimer timer;
+
+        auto createItems = [=](){
+            return createTestItems("bulk", count, QIcon::fromTheme("folder"));
+        };
+
+        // one rowsInserted() per row
+        DesktopView rowByRowView;
+        QStandardItemModel rowByRowModel;
+        rowByRowView.setModel(&rowByRowModel);
+        auto items = createItems();
+        timer.start();
+        for (auto item : items) {
+            rowByRowModel.appendRow(item);
+        }
+        qint64 rowByRowCost = timer.elapsed();
+
+        // one rowsInserted(0, count - 1)
+        DesktopView bulkView;
+        QStandardItemModel bulkModel;
+        bulkView.setModel(&bulkModel);
+        items = createItems();
+        timer.restart();
+        bulkModel.invisibleRootItem()->appendRows(items);
+        qint64 bulkCost = timer.elapsed();
+
+        qDebug()<<"insert"<<count<<"items, row by row:"<<rowByRowCost<<"ms, bulk:"<<bulkCost<<"ms";
+    });
+#endif
+
+//#define TEST_LOAD_DIRECTORY
+#ifdef TEST_LOAD_DIRECTORY
+    QTemporaryDir loadDir;
+    createTestFiles(loadDir.path(), 20000);
+    FileSystemModel loadModel;
+    DesktopView loadView;
+    loadView.setModel(&loadModel);
+    QObject::connect(&loadModel, &FileSystemModel::firstBatchLoaded, [&](qint64 msecs){
+        qDebug()<<"first batch of"<<loadModel.rowCount()<<"rows loaded in"<<msecs<<"ms";
+    });
+    QObject::connect(&loadModel, &FileSystemModel::loadFinished, [&](qint64 msecs){
+        qDebug()<<"all"<<loadModel.rowCount()<<"rows loaded in"<<msecs<<"ms";
+    });
+    loadModel.setRootPath(loadDir.path());
+#endif
+
+//#define TEST_WATCH_DIRECTORY
+#ifdef TEST_WATCH_DIRECTORY
+    QTemporaryDir watchDir;
+    FileSystemModel watchModel;
+    DesktopView watchView;
+    watchView.setModel(&watchModel);
+    watchModel.setRootPath(watchDir.path());
+    int rowsInsertedCount = 0;
+    int rowsRemovedCount = 0;
+    QObject::connect(&watchModel, &QAbstractItemModel::rowsInserted, [&]{
+        rowsInsertedCount++;
+    });
+    QObject::connect(&watchModel, &QAbstractItemModel::rowsRemoved, [&]{
+        rowsRemovedCount++;
+    });
+    QTimer::singleShot(1000, [&]{
+        createTestFiles(watchDir.path(), 10000);
+        QTimer::singleShot(2000, [&]{
+            qDebug()<<watchModel.rowCount()<<"rows after creating 10000 files, rowsInserted:"<<rowsInsertedCount;
+            for (int i = 0; i < 10000; i += 2) {
+                QFile::remove(testFilePath(watchDir.path(), i));
+            }
+            QTimer::singleShot(2000, [&]{
+                qDebug()<<watchModel.rowCount()<<"rows after deleting 5000 files, rowsRemoved:"<<rowsRemovedCount;
+            });
+        });
+    });
+#endif
+
+//#define TEST_STARTUP_WITH_POSITIONS
+#ifdef TEST_STARTUP_WITH_POSITIONS
+    QTemporaryDir startupDir;
+    QTemporaryDir startupStoreDir;
+    createTestFiles(startupDir.path(), 3000);
+    auto startup = [&](const QString &description){
+        DesktopView view;
+        view.setPositionStorePath(startupStoreDir.filePath("item-positions"));
+        FileSystemModel model;
+        view.setModel(&model);
+
+        // the first frame is painted right after the first batch of rows is laid out.
+        QElapsedTimer timer;
+        QEventLoop loop;
+        QObject::connect(&model, &FileSystemModel::firstBatchLoaded, &loop, &QEventLoop::quit);
+        timer.start();
+        model.setRootPath(startupDir.path());
+        loop.exec();
+        view.grab();
+        qDebug()<<"time to first frame"<<description<<timer.elapsed()<<"ms";
+
+        // positions of all rows are saved for the next startup
+        if (model.isLoading()) {
+            QObject::connect(&model, &FileSystemModel::loadFinished, &loop, &QEventLoop::quit);
+            loop.exec();
+        }
+        view._saveItemsPoses();
+    };
+    QTimer::singleShot(1000, [&]{
+        startup("without stored positions:");
+        startup("with stored positions:");
+    });
+#endif
+
+//#define TEST_HOTPLUG_STORM
+#ifdef TEST_HOTPLUG_STORM
+    QTimer::singleShot(2000, [&]{
+        // 模拟扩展坞接入时的连续geometryChanged
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < 10; i++) {
+            a.primaryScreen()->geometryChanged(QRect(0, 0, 800 + i * 10, 600));
+        }
+        v.setGridSize(QSize(120, 150));
+        v.flushPendingLayout();
+        qDebug()<<"hotplug storm relayout:"<<timer.elapsed()<<"ms, saved relayouts:"<<v.savedRelayoutsCount();
+        QTimer::singleShot(2000, [&]{
+            a.primaryScreen()->geometryChanged(a.primaryScreen()->geometry());
+            v.setGridSize(QSize(100, 150));
+        });
+    });
+#endif
+
+#ifdef TEST_ITEM_TABLE_MEMORY
+    QTimer::singleShot(1000, [&]{
+        const int count = 10000;
+        QStringList uris;
+        for (int i = 0; i < count; i++) {
+            uris<<testItemUri("item-table", i);
+        }
+        auto heapUsed = []() {
+            // mallinfo() is deprecated since glibc 2.33, and its counters are int
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+            return size_t(mallinfo2().uordblks);
+#else
+            return size_t(mallinfo().uordblks);
+#endif
+        };
+
+        // uri keyed containers, one per kind of layout state (the layout before the item table).
+        // the uris are implicitly shared as they were, data(Qt::UserRole) returns the model's string.
+        size_t before = heapUsed();
+        {
+            QSet<QString> items, floatItems;
+            QHash<QString, QPoint> posesCached, screenItems, metaPoses;
+            QHash<QString, void *> itemScreens;
+            QHash<QString, QPersistentModelIndex> uriIndexes;
+            for (int i = 0; i < count; i++) {
+                const auto &uri = uris.at(i);
+                items<<uri;
+                floatItems<<uri;
+                posesCached.insert(uri, QPoint(i, i));
+                screenItems.insert(uri, QPoint(i, i));
+                metaPoses.insert(uri, QPoint(i, i));
+                itemScreens.insert(uri, nullptr);
+                uriIndexes.insert(uri, QPersistentModelIndex());
+            }
+            qDebug()<<"uri keyed containers:"<<(heapUsed() - before) / count<<"bytes per item";
+
+            QElapsedTimer timer;
+            timer.start();
+            int found = 0;
+            for (auto uri : uris) {
+                found += items.contains(uri) + floatItems.contains(uri) + posesCached.contains(uri)
+                        + itemScreens.contains(uri) + uriIndexes.contains(uri);
+            }
+            qDebug()<<"uri keyed lookups:"<<timer.nsecsElapsed() / count<<"ns per item"<<found;
+        }
+
+        before = heapUsed();
+        {
+            ItemTable table;
+            QVector<ItemId> cells(count);
+            for (int i = 0; i < count; i++) {
+                auto id = table.intern(uris.at(i));
+                auto &record = table.record(id);
+                record.gridPos = record.metaPos = record.cachedPos = QPoint(i, i);
+                record.setFlag(ItemRecord::Float);
+                cells[i] = id;
+            }
+            qDebug()<<"item table:"<<(heapUsed() - before) / count<<"bytes per item";
+
+            QElapsedTimer timer;
+            timer.start();
+            int found = 0;
+            for (auto uri : uris) {
+                auto id = table.id(uri);
+                const auto &record = table.record(id);
+                found += record.testFlag(ItemRecord::Float) + record.testFlag(ItemRecord::CachedPos) + (record.screenId >= 0);
+            }
+            qDebug()<<"item table lookups:"<<timer.nsecsElapsed() / count<<"ns per item"<<found;
+        }
+
+        // the whole view, model rows are created before measuring
+        QStandardItemModel memoryModel;
+        memoryModel.invisibleRootItem()->appendRows(createTestItems("item-table", count));
+        before = heapUsed();
+        auto memoryView = new DesktopView;
+        memoryView->setModel(&memoryModel);
+        qDebug()<<"desktop view layout state:"<<(heapUsed() - before) / count<<"bytes per item";
+        delete memoryView;
+    });
+#endif
+
+//#define TEST_LAYOUT_ENGINE
+#ifdef TEST_LAYOUT_ENGINE
+    QTimer::singleShot(1000, [&]{
+        // 脱离窗口和屏幕，随机的插拔/插入/删除序列直接驱动布局引擎
+        QRandomGenerator random(2022);
+        LayoutEngine engine;
+        engine.addScreen(QRect(0, 0, 1920, 1080), QMargins(0, 0, 0, 46), QSize(100, 150));
+        engine.addScreen(QRect(1920, 0, 1280, 1024), QMargins(), QSize(100, 150));
+
+        QVector<ItemId> inserted;
+        int uriSeed = 0;
+        int operations = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < 20000; i++) {
+            switch (random.bounded(6)) {
+            case 0: {
+                // 插拔屏幕
+                int screenId = random.bounded(engine.screenCount());
+                engine.setScreenValid(screenId, !engine.isValidScreen(screenId));
+                engine.relayoutScreens(QVector<int>()<<screenId);
+                break;
+            }
+            case 1: {
+                int screenId = random.bounded(engine.screenCount());
+                const auto &screen = engine.screen(screenId);
+                engine.setScreenGeometry(screenId, QRect(screen.geometry.topLeft(), QSize(800 + random.bounded(1200), 600 + random.bounded(600))),
+                                         screen.margins, QSize(80 + random.bounded(60), 120 + random.bounded(60)));
+                engine.relayoutScreens(QVector<int>()<<screenId);
+                break;
+            }
+            case 2:
+            case 3: {
+                QVector<ItemId> ids;
+                for (int j = random.bounded(20); j >= 0; j--) {
+                    auto id = engine.items().intern(QString("file:///fuzz/%1").arg(uriSeed++));
+                    if (random.bounded(2))
+                        engine.setItemMetaPos(random.bounded(engine.screenCount()), id, QPoint(random.bounded(20), random.bounded(8)));
+                    ids<<id;
+                }
+                engine.insertItems(ids);
+                inserted<<ids;
+                break;
+            }
+            case 4: {
+                QVector<ItemId> ids;
+                for (int j = qMin(inserted.count(), random.bounded(20)); j > 0; j--) {
+                    ids<<inserted.takeAt(random.bounded(inserted.count()));
+                }
+                engine.removeItems(ids);
+                break;
+            }
+            case 5: {
+                if (inserted.isEmpty())
+                    break;
+                QVector<ItemId> ids;
+                ids<<inserted.at(random.bounded(inserted.count()));
+                engine.dropItems(ids, QPoint(random.bounded(800) - 400, random.bounded(600) - 300));
+                engine.confirmPositions();
+                break;
+            }
+            }
+            operations++;
+
+            if (!engine.isConsistent()) {
+                qCritical()<<"layout engine inconsistent after operation"<<i;
+                return;
+            }
+        }
+        qDebug()<<"layout engine:"<<operations<<"operations in"<<timer.elapsed()<<"ms, items:"<<inserted.count()
+               <<"out of grid:"<<engine.itemsOutOfGrid().count();
+    });
+#endif
+
+#if defined(TEST_RECORD_EVENTS) || defined(TEST_REPLAY_EVENTS)
+    QString eventLogPath = qEnvironmentVariableIsSet("DESKTOP_VIEW_EVENT_LOG")? QString::fromLocal8Bit(qgetenv("DESKTOP_VIEW_EVENT_LOG")): EVENT_LOG_PATH;
+#endif
+
+#ifdef TEST_RECORD_EVENTS
+    // 记录真实会话，退出时写完
+    EventRecorder recorder(&v, eventLogPath);
+#endif
+
+#ifdef TEST_REPLAY_EVENTS
+    QTimer::singleShot(0, [&]{
+        DesktopView replayView;
+        ReplayModel replayModel;
+        EventReplayer replayer(&replayView, &replayModel);
+        if (!replayer.replay(eventLogPath)) {
+            a.exit(1);
+            return;
+        }
+
+        int eventsCount = 0;
+        for (auto it = replayer.stats().constBegin(); it != replayer.stats().constEnd(); it++) {
+            eventsCount += it.value().count;
+            qDebug()<<"event type"<<it.key()<<"count:"<<it.value().count
+                   <<"avg:"<<it.value().totalNsecs / it.value().count / 1000<<"us, max:"<<it.value().maxNsecs / 1000<<"us";
+        }
+        qDebug()<<"replayed"<<eventsCount<<"events in"<<replayer.elapsed() / 1000000<<"ms, items:"<<replayModel.rowCount()
+               <<"visible:"<<replayView.visibleItems().count();
+        a.exit(0);
+    });
+#endif
 
     return a.exec();
 }
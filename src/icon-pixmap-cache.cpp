@@ -0,0 +1,49 @@
+#include "icon-pixmap-cache.h"
+
+IconPixmapCache::IconPixmapCache(int maxCostKB)
+{
+    m_pixmaps.setMaxCost(maxCostKB);
+}
+
+QPixmap IconPixmapCache::pixmap(const QIcon &icon, const QSize &size, QIcon::Mode mode, qreal devicePixelRatio)
+{
+    if (icon.isNull() || size.isEmpty())
+        return QPixmap();
+
+    // theme icons are identified by name and theme, others by their cache key.
+    QString identity = icon.name().isEmpty()? QString::number(icon.cacheKey()): QIcon::themeName() + "/" + icon.name();
+    QString key = QString("%1_%2x%3_%4_%5").arg(identity).arg(size.width()).arg(size.height()).arg(int(mode)).arg(devicePixelRatio);
+
+    if (auto cached = m_pixmaps.object(key)) {
+        m_hits++;
+        return *cached;
+    }
+
+    m_misses++;
+    auto pixmap = new QPixmap(icon.pixmap(size * devicePixelRatio, mode));
+    pixmap->setDevicePixelRatio(devicePixelRatio);
+    int cost = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+    QPixmap result = *pixmap;
+    m_pixmaps.insert(key, pixmap, cost);
+    return result;
+}
+
+void IconPixmapCache::clear()
+{
+    m_pixmaps.clear();
+}
+
+void IconPixmapCache::setMaxCostKB(int maxCostKB)
+{
+    m_pixmaps.setMaxCost(maxCostKB);
+}
+
+int IconPixmapCache::maxCostKB() const
+{
+    return m_pixmaps.maxCost();
+}
+
+int IconPixmapCache::totalCostKB() const
+{
+    return m_pixmaps.totalCost();
+}
@@ -0,0 +1,33 @@
+#ifndef ICONPIXMAPCACHE_H
+#define ICONPIXMAPCACHE_H
+
+#include <QCache>
+#include <QIcon>
+#include <QPixmap>
+#include <QSize>
+
+// rendered icons of view, keyed by icon identity, size, mode and device pixel ratio.
+// least recently used pixmaps are dropped once the memory budget is used up.
+class IconPixmapCache
+{
+public:
+    explicit IconPixmapCache(int maxCostKB = 32 * 1024);
+
+    QPixmap pixmap(const QIcon &icon, const QSize &size, QIcon::Mode mode, qreal devicePixelRatio);
+
+    void clear();
+
+    void setMaxCostKB(int maxCostKB);
+    int maxCostKB() const;
+    int totalCostKB() const;
+
+    quint64 hits() const {return m_hits;}
+    quint64 misses() const {return m_misses;}
+
+private:
+    QCache<QString, QPixmap> m_pixmaps; //cost in KB
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+#endif // ICONPIXMAPCACHE_H
@@ -0,0 +1,196 @@
+#include "item-position-store.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QtEndian>
+#include <QDebug>
+
+// file layout, little endian:
+// header: magic, version, record count, payload size, payload crc32
+// record: screen id (int32), grid x (int32), grid y (int32), uri size (uint16), uri (utf8)
+#define STORE_MAGIC 0x53505644 //"DVPS"
+#define STORE_VERSION 1
+#define HEADER_SIZE 20
+#define RECORD_FIXED_SIZE 14
+
+static quint32 crc32(const uchar *data, int size)
+{
+    static quint32 table[256];
+    static bool tableInited = false;
+    if (!tableInited) {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1)? 0xEDB88320 ^ (c >> 1): c >> 1;
+            }
+            table[i] = c;
+        }
+        tableInited = true;
+    }
+
+    quint32 crc = 0xFFFFFFFF;
+    for (int i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+ItemPositionStore::ItemPositionStore(const QString &path, QObject *parent) : QObject(parent)
+{
+    m_path = path;
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(1000);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ItemPositionStore::flush);
+}
+
+ItemPositionStore::~ItemPositionStore()
+{
+    flush();
+}
+
+QString ItemPositionStore::path() const
+{
+    return m_path;
+}
+
+bool ItemPositionStore::load()
+{
+    m_positions.clear();
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (file.size() < HEADER_SIZE) {
+        qWarning()<<"position store is broken, ignored:"<<m_path;
+        return false;
+    }
+
+    auto data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+
+    quint32 magic = qFromLittleEndian<quint32>(data);
+    quint32 version = qFromLittleEndian<quint32>(data + 4);
+    quint32 count = qFromLittleEndian<quint32>(data + 8);
+    quint32 payloadSize = qFromLittleEndian<quint32>(data + 12);
+    quint32 crc = qFromLittleEndian<quint32>(data + 16);
+    const uchar *payload = data + HEADER_SIZE;
+    if (magic != STORE_MAGIC || version != STORE_VERSION || payloadSize != file.size() - HEADER_SIZE || crc != crc32(payload, payloadSize)) {
+        // torn or foreign file, start from an empty table.
+        qWarning()<<"position store is broken, ignored:"<<m_path;
+        file.unmap(data);
+        return false;
+    }
+
+    m_positions.reserve(count);
+    const uchar *ptr = payload;
+    const uchar *end = payload + payloadSize;
+    for (quint32 i = 0; i < count && ptr + RECORD_FIXED_SIZE <= end; i++) {
+        ItemPosition position;
+        position.screenId = qFromLittleEndian<qint32>(ptr);
+        position.gridPos.setX(qFromLittleEndian<qint32>(ptr + 4));
+        position.gridPos.setY(qFromLittleEndian<qint32>(ptr + 8));
+        quint16 uriSize = qFromLittleEndian<quint16>(ptr + 12);
+        ptr += RECORD_FIXED_SIZE;
+        if (ptr + uriSize > end)
+            break;
+        m_positions.insert(QString::fromUtf8(reinterpret_cast<const char *>(ptr), uriSize), position);
+        ptr += uriSize;
+    }
+
+    file.unmap(data);
+    return true;
+}
+
+ItemPosition ItemPositionStore::position(const QString &uri) const
+{
+    return m_positions.value(uri);
+}
+
+const QHash<QString, ItemPosition> &ItemPositionStore::positions() const
+{
+    return m_positions;
+}
+
+void ItemPositionStore::setPosition(const QString &uri, int screenId, const QPoint &gridPos)
+{
+    auto &position = m_positions[uri];
+    if (position.screenId == screenId && position.gridPos == gridPos)
+        return;
+
+    position.screenId = screenId;
+    position.gridPos = gridPos;
+    scheduleFlush();
+}
+
+void ItemPositionStore::removePosition(const QString &uri)
+{
+    if (m_positions.remove(uri)) {
+        scheduleFlush();
+    }
+}
+
+void ItemPositionStore::setFlushDelay(int msecs)
+{
+    m_flushTimer.setInterval(msecs);
+}
+
+bool ItemPositionStore::flush()
+{
+    m_flushTimer.stop();
+    if (!m_dirty)
+        return true;
+
+    QByteArray payload;
+    payload.reserve(m_positions.count() * (RECORD_FIXED_SIZE + 64));
+    quint32 count = 0;
+    uchar fixed[RECORD_FIXED_SIZE];
+    for (auto it = m_positions.constBegin(); it != m_positions.constEnd(); it++) {
+        auto uri = it.key().toUtf8();
+        if (uri.size() > 0xFFFF)
+            continue;
+        qToLittleEndian<qint32>(it.value().screenId, fixed);
+        qToLittleEndian<qint32>(it.value().gridPos.x(), fixed + 4);
+        qToLittleEndian<qint32>(it.value().gridPos.y(), fixed + 8);
+        qToLittleEndian<quint16>(uri.size(), fixed + 12);
+        payload.append(reinterpret_cast<const char *>(fixed), RECORD_FIXED_SIZE);
+        payload.append(uri);
+        count++;
+    }
+
+    uchar header[HEADER_SIZE];
+    qToLittleEndian<quint32>(STORE_MAGIC, header);
+    qToLittleEndian<quint32>(STORE_VERSION, header + 4);
+    qToLittleEndian<quint32>(count, header + 8);
+    qToLittleEndian<quint32>(payload.size(), header + 12);
+    qToLittleEndian<quint32>(crc32(reinterpret_cast<const uchar *>(payload.constData()), payload.size()), header + 16);
+
+    // QSaveFile syncs the temporary file and renames it over the old one.
+    QDir().mkpath(QFileInfo(m_path).path());
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning()<<"can not save item positions:"<<file.errorString();
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(header), HEADER_SIZE);
+    file.write(payload);
+    if (!file.commit()) {
+        qWarning()<<"can not save item positions:"<<file.errorString();
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+void ItemPositionStore::scheduleFlush()
+{
+    m_dirty = true;
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef ITEMPOSITIONSTORE_H
+#define ITEMPOSITIONSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QPoint>
+#include <QTimer>
+
+struct ItemPosition
+{
+    int screenId = -1;
+    QPoint gridPos = QPoint(-1, -1);
+
+    bool isValid() const {return screenId >= 0;}
+};
+
+// persistent uri -> (screen id, grid pos) table.
+// changes are written behind in one batch, the whole file is replaced
+// atomically, so a torn write never leaves a half written table.
+class ItemPositionStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ItemPositionStore(const QString &path, QObject *parent = nullptr);
+    ~ItemPositionStore() override;
+
+    QString path() const;
+
+    bool load();
+
+    ItemPosition position(const QString &uri) const;
+    const QHash<QString, ItemPosition> &positions() const;
+
+    void setPosition(const QString &uri, int screenId, const QPoint &gridPos);
+    void removePosition(const QString &uri);
+
+    void setFlushDelay(int msecs);
+
+public slots:
+    bool flush();
+
+private:
+    void scheduleFlush();
+
+    QString m_path;
+    QHash<QString, ItemPosition> m_positions;
+
+    bool m_dirty = false;
+    QTimer m_flushTimer;
+};
+
+#endif // ITEMPOSITIONSTORE_H
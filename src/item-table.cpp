@@ -0,0 +1,55 @@
+#include "item-table.h"
+
+ItemId ItemTable::intern(const QString &uri)
+{
+    auto it = m_ids.constFind(uri);
+    if (it != m_ids.constEnd())
+        return it.value();
+
+    ItemId id;
+    if (!m_freeIds.isEmpty()) {
+        id = m_freeIds.takeLast();
+    } else {
+        id = m_records.count();
+        m_records.append(ItemRecord());
+    }
+    m_records[id].uri = uri;
+    m_ids.insert(uri, id);
+    return id;
+}
+
+ItemId ItemTable::id(const QString &uri) const
+{
+    return m_ids.value(uri, INVALID_ITEM_ID);
+}
+
+void ItemTable::rename(ItemId id, const QString &uri)
+{
+    auto &record = m_records[id];
+    m_ids.remove(record.uri);
+    record.uri = uri;
+    m_ids.insert(uri, id);
+}
+
+void ItemTable::release(ItemId id)
+{
+    if (!isValid(id))
+        return;
+
+    m_ids.remove(m_records.at(id).uri);
+    m_records[id] = ItemRecord();
+    m_freeIds<<id;
+}
+
+void ItemTable::reserve(int size)
+{
+    m_ids.reserve(size);
+    m_records.reserve(size);
+}
+
+void ItemTable::clear()
+{
+    m_ids.clear();
+    m_records.clear();
+    m_freeIds.clear();
+}
@@ -0,0 +1,79 @@
+#ifndef ITEMTABLE_H
+#define ITEMTABLE_H
+
+#include <QHash>
+#include <QVector>
+#include <QPoint>
+#include <QPersistentModelIndex>
+
+typedef quint32 ItemId;
+#define INVALID_ITEM_ID ItemId(0xFFFFFFFF)
+
+// all layout state of one desktop item. screen ids are indexes of DesktopView screens.
+struct ItemRecord
+{
+    enum Flag {
+        InModel = 0x01, //model has a row for this uri, otherwise only the metainfo is known
+        Float = 0x02, //没有确认位置的元素
+        CachedPos = 0x04, //cachedPos is valid
+        Selected = 0x08
+    };
+
+    QString uri;
+    QPersistentModelIndex index;
+    QPoint gridPos = QPoint(-1, -1); //grid pos on screenId
+    QPoint metaPos = QPoint(-1, -1); //metainfo grid pos on metaScreenId
+    QPoint cachedPos; //global position
+    qint8 screenId = -1;
+    qint8 metaScreenId = -1;
+    quint8 flags = 0;
+
+    bool testFlag(Flag flag) const {return flags & flag;}
+    void setFlag(Flag flag, bool on = true) {flags = on? (flags | flag): (flags & ~flag);}
+    bool hasMetaPos() const {return metaScreenId >= 0;}
+};
+
+// interned uri -> 32 bit id, and one record per id.
+// the uri is stored and hashed once, everything else refers to the item by id.
+// ids of released records are reused.
+class ItemTable
+{
+public:
+    ItemId intern(const QString &uri); //id of uri, a record is created if uri is unknown
+    ItemId id(const QString &uri) const; //INVALID_ITEM_ID if uri is unknown
+    void rename(ItemId id, const QString &uri); //uri must be unknown
+    void release(ItemId id);
+
+    bool isValid(ItemId id) const {return id < ItemId(m_records.count()) && !m_records.at(id).uri.isEmpty();}
+    ItemRecord &record(ItemId id) {return m_records[id];}
+    const ItemRecord &record(ItemId id) const {return m_records.at(id);}
+    const QString &uri(ItemId id) const {return m_records.at(id).uri;}
+
+    int count() const {return m_ids.count();}
+    void reserve(int size);
+    void clear();
+
+    // f(ItemId, ItemRecord &) for every valid record, in id order.
+    template <typename F>
+    void forEach(F f) {
+        for (ItemId id = 0; id < ItemId(m_records.count()); id++) {
+            if (!m_records.at(id).uri.isEmpty())
+                f(id, m_records[id]);
+        }
+    }
+
+    template <typename F>
+    void forEach(F f) const {
+        for (ItemId id = 0; id < ItemId(m_records.count()); id++) {
+            if (!m_records.at(id).uri.isEmpty())
+                f(id, m_records.at(id));
+        }
+    }
+
+private:
+    QHash<QString, ItemId> m_ids;
+    QVector<ItemRecord> m_records;
+    QVector<ItemId> m_freeIds;
+};
+
+#endif // ITEMTABLE_H
@@ -0,0 +1,87 @@
+#include "label-layout-cache.h"
+
+#include <QPainter>
+#include <QTextLayout>
+#include <QFontMetrics>
+
+const LabelLayout &LabelLayoutCache::layout(const QString &uri, const QString &text, const QFont &font, const QSize &size)
+{
+    auto &layout = m_layouts[uri];
+    if (layout.text != text || layout.font != font || layout.size != size) {
+        layout.text = text;
+        layout.font = font;
+        layout.size = size;
+        relayout(layout);
+    }
+    return layout;
+}
+
+void LabelLayoutCache::draw(QPainter *painter, const QPoint &pos, const LabelLayout &layout)
+{
+    painter->setFont(layout.font);
+    for (int i = 0; i < layout.lines.count(); i++) {
+        painter->drawStaticText(pos + layout.offsets.at(i), layout.lines.at(i));
+    }
+}
+
+void LabelLayoutCache::invalidate(const QString &uri)
+{
+    m_layouts.remove(uri);
+}
+
+void LabelLayoutCache::clear()
+{
+    m_layouts.clear();
+}
+
+void LabelLayoutCache::relayout(LabelLayout &layout)
+{
+    layout.lines.clear();
+    layout.offsets.clear();
+    layout.boundingRect = QRectF();
+
+    QFontMetrics fm(layout.font);
+    int width = layout.size.width();
+    if (width <= 0 || layout.text.isEmpty())
+        return;
+
+    QTextOption option(Qt::AlignHCenter);
+    option.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    QTextLayout textLayout(layout.text, layout.font);
+    textLayout.setTextOption(option);
+
+    QStringList lines;
+    textLayout.beginLayout();
+    int height = 0;
+    while (true) {
+        auto line = textLayout.createLine();
+        if (!line.isValid())
+            break;
+
+        line.setLineWidth(width);
+        height += fm.lineSpacing();
+        auto lineText = layout.text.mid(line.textStart(), line.textLength());
+        if (height + fm.lineSpacing() > layout.size.height()) {
+            // no space for next line, elide the rest of text.
+            lineText = fm.elidedText(layout.text.mid(line.textStart()), Qt::ElideRight, width);
+            lines<<lineText;
+            break;
+        }
+        lines<<lineText.trimmed();
+    }
+    textLayout.endLayout();
+
+    int y = 0;
+    for (auto lineText : lines) {
+        QStaticText staticText(lineText);
+        staticText.setTextFormat(Qt::PlainText);
+        staticText.prepare(QTransform(), layout.font);
+        auto lineSize = staticText.size();
+        QPointF offset((width - lineSize.width())/2, y);
+
+        layout.lines<<staticText;
+        layout.offsets<<offset;
+        layout.boundingRect |= QRectF(offset, lineSize);
+        y += fm.lineSpacing();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef LABELLAYOUTCACHE_H
+#define LABELLAYOUTCACHE_H
+
+#include <QHash>
+#include <QFont>
+#include <QRectF>
+#include <QVector>
+#include <QStaticText>
+
+class QPainter;
+
+// wrapped and elided label of an item, one prepared QStaticText per line.
+struct LabelLayout
+{
+    QString text;
+    QFont font;
+    QSize size;
+
+    QVector<QStaticText> lines;
+    QVector<QPointF> offsets; //related to the top left of the label area
+    QRectF boundingRect;
+};
+
+// labels of view items, keyed by item uri. a layout is reused as long as
+// text, font and label area size are not changed.
+class LabelLayoutCache
+{
+public:
+    const LabelLayout &layout(const QString &uri, const QString &text, const QFont &font, const QSize &size);
+    void draw(QPainter *painter, const QPoint &pos, const LabelLayout &layout);
+
+    void invalidate(const QString &uri);
+    void clear();
+
+private:
+    void relayout(LabelLayout &layout);
+
+    QHash<QString, LabelLayout> m_layouts;
+};
+
+#endif // LABELLAYOUTCACHE_H
@@ -0,0 +1,828 @@
+#include "layout-engine.h"
+#include "trace.h"
+
+#include <algorithm>
+
+#define INVALID_POS QPoint(-1, -1)
+
+int LayoutEngine::addScreen(const QRect &geometry, const QMargins &margins, const QSize &gridSize)
+{
+    m_screens.append(LayoutScreen());
+    int screenId = m_screens.count() - 1;
+    setScreenGeometry(screenId, geometry, margins, gridSize);
+    return screenId;
+}
+
+bool LayoutEngine::isValidScreen(int screenId) const
+{
+    return screenId >= 0 && screenId < m_screens.count() && m_screens.at(screenId).valid;
+}
+
+void LayoutEngine::setScreenGeometry(int screenId, const QRect &geometry, const QMargins &margins, const QSize &gridSize)
+{
+    auto &screen = m_screens[screenId];
+    screen.geometry = geometry;
+    screen.margins = margins;
+    screen.area = geometry.marginsRemoved(margins);
+    if (!gridSize.isEmpty())
+        screen.gridSize = gridSize;
+    recalculateGrid(screenId);
+}
+
+void LayoutEngine::setScreenValid(int screenId, bool valid)
+{
+    m_screens[screenId].valid = valid;
+}
+
+void LayoutEngine::swapScreens(int screenId1, int screenId2)
+{
+    if (screenId1 == screenId2)
+        return;
+
+    std::swap(m_screens[screenId1], m_screens[screenId2]);
+    m_items.forEach([=](ItemId, ItemRecord &record) {
+        if (record.screenId == screenId1 || record.screenId == screenId2)
+            record.screenId = record.screenId == screenId1? screenId2: screenId1;
+        if (record.metaScreenId == screenId1 || record.metaScreenId == screenId2)
+            record.metaScreenId = record.metaScreenId == screenId1? screenId2: screenId1;
+    });
+}
+
+void LayoutEngine::recalculateGrid(int screenId)
+{
+    auto &screen = m_screens[screenId];
+    screen.maxColumn = screen.area.width()/screen.gridSize.width();
+    screen.maxRow = screen.area.height()/screen.gridSize.height();
+    if (/*screen.area.width() % screen.gridSize.width() == 0 && */screen.maxColumn > 0) {
+        screen.maxColumn--;
+    }
+    if (/*screen.area.height() % screen.gridSize.height() == 0 && */screen.maxRow > 0) {
+        screen.maxRow--;
+    }
+
+    rebuildCells(screenId);
+}
+
+int LayoutEngine::cellIndex(int screenId, const QPoint &gridPos) const
+{
+    const auto &screen = m_screens.at(screenId);
+    if (gridPos.x() < 0 || gridPos.y() < 0 || gridPos.x() > screen.maxColumn || gridPos.y() > screen.maxRow)
+        return -1;
+
+    int index = gridPos.x() * (screen.maxRow + 1) + gridPos.y();
+    if (index >= screen.cells.count())
+        return -1;
+    return index;
+}
+
+void LayoutEngine::occupyCell(int screenId, ItemId id, const QPoint &gridPos)
+{
+    int index = cellIndex(screenId, gridPos);
+    if (index < 0)
+        return;
+
+    auto &screen = m_screens[screenId];
+    screen.cells[index] = id;
+    if (index == screen.firstFreeCell) {
+        // every cell before the cursor is taken, so the cursor only moves forward here.
+        while (screen.firstFreeCell < screen.cells.count() && screen.cells.at(screen.firstFreeCell) != INVALID_ITEM_ID) {
+            screen.firstFreeCell++;
+        }
+    }
+}
+
+void LayoutEngine::releaseCell(int screenId, const QPoint &gridPos)
+{
+    int index = cellIndex(screenId, gridPos);
+    if (index < 0)
+        return;
+
+    auto &screen = m_screens[screenId];
+    screen.cells[index] = INVALID_ITEM_ID;
+    if (index < screen.firstFreeCell)
+        screen.firstFreeCell = index;
+}
+
+void LayoutEngine::rebuildCells(int screenId)
+{
+    // items out of grid keep their grid pos, but they do not take any cell.
+    auto &screen = m_screens[screenId];
+    screen.cells.fill(INVALID_ITEM_ID, (screen.maxColumn + 1) * (screen.maxRow + 1));
+    screen.firstFreeCell = 0;
+    m_items.forEach([&](ItemId id, ItemRecord &record) {
+        if (record.screenId == screenId)
+            occupyCell(screenId, id, record.gridPos);
+    });
+}
+
+ItemId LayoutEngine::itemAt(int screenId, const QPoint &gridPos) const
+{
+    int index = cellIndex(screenId, gridPos);
+    if (index < 0)
+        return INVALID_ITEM_ID;
+    return m_screens.at(screenId).cells.at(index);
+}
+
+bool LayoutEngine::isGridPosFree(int screenId, const QPoint &gridPos) const
+{
+    int index = cellIndex(screenId, gridPos);
+    return index >= 0 && m_screens.at(screenId).cells.at(index) == INVALID_ITEM_ID;
+}
+
+void LayoutEngine::insertItem(int screenId, ItemId id, const QPoint &gridPos)
+{
+    // an item belongs to one screen only.
+    takeItem(id);
+    auto &record = m_items.record(id);
+    record.screenId = screenId;
+    record.gridPos = gridPos;
+    occupyCell(screenId, id, gridPos);
+}
+
+void LayoutEngine::takeItem(ItemId id)
+{
+    auto &record = m_items.record(id);
+    if (record.screenId < 0)
+        return;
+
+    releaseCell(record.screenId, record.gridPos);
+    record.screenId = -1;
+    record.gridPos = INVALID_POS;
+}
+
+void LayoutEngine::clearScreen(int screenId)
+{
+    m_items.forEach([=](ItemId, ItemRecord &record) {
+        if (record.screenId == screenId) {
+            record.screenId = -1;
+            record.gridPos = INVALID_POS;
+        }
+    });
+    m_screens[screenId].cells.fill(INVALID_ITEM_ID);
+    m_screens[screenId].firstFreeCell = 0;
+}
+
+QPoint LayoutEngine::placeItem(int screenId, ItemId id, const QPoint &lastPos)
+{
+    // remove current pos
+    if (m_items.record(id).screenId == screenId)
+        takeItem(id);
+
+    int index = cellIndex(screenId, lastPos);
+    if (index < 0) {
+        // out of grid
+        return INVALID_POS;
+    }
+
+    // cells are column major, so walking the indexes keeps the fill order
+    // (top to bottom, then left to right). no free cell before the cursor.
+    const auto &screen = m_screens.at(screenId);
+    int rowCount = screen.maxRow + 1;
+    int start = qMax(index, screen.firstFreeCell);
+    for (index = start; index < screen.cells.count(); index++) {
+        if (screen.cells.at(index) == INVALID_ITEM_ID) {
+            m_cellsScanned += index - start + 1;
+            QPoint pos(index / rowCount, index % rowCount);
+            insertItem(screenId, id, pos);
+            return pos;
+        }
+    }
+    m_cellsScanned += index - start;
+    return INVALID_POS;
+}
+
+int LayoutEngine::placeItems(int screenId, const QVector<ItemId> &ids, int from)
+{
+    for (int i = from; i < ids.count(); i++) {
+        if (placeItem(screenId, ids.at(i)) == INVALID_POS) {
+            // screen is full
+            return i;
+        }
+    }
+    return ids.count();
+}
+
+bool LayoutEngine::setItemGridPos(int screenId, ItemId id, const QPoint &gridPos)
+{
+    // an item on no screen has INVALID_POS too, it only holds a cell of this grid.
+    if (cellIndex(screenId, gridPos) < 0)
+        return false;
+    if (itemGridPos(screenId, id) == gridPos)
+        return true;
+
+    if (isGridPosFree(screenId, gridPos)) {
+        insertItem(screenId, id, gridPos);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+QPoint LayoutEngine::itemGridPos(int screenId, ItemId id) const
+{
+    const auto &record = m_items.record(id);
+    return record.screenId == screenId? record.gridPos: INVALID_POS;
+}
+
+QVector<ItemId> LayoutEngine::itemsOnScreen(int screenId) const
+{
+    QVector<ItemId> list;
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.screenId == screenId)
+            list<<id;
+    });
+    return list;
+}
+
+QVector<ItemId> LayoutEngine::itemsVisibleOnScreen(int screenId) const
+{
+    if (!isValidScreen(screenId))
+        return QVector<ItemId>();
+
+    const auto &screen = m_screens.at(screenId);
+    QVector<ItemId> list;
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.screenId == screenId && record.gridPos.x() <= screen.maxColumn && record.gridPos.y() <= screen.maxRow)
+            list<<id;
+    });
+    return list;
+}
+
+QVector<ItemId> LayoutEngine::itemsOutOfScreen(int screenId) const
+{
+    const auto &screen = m_screens.at(screenId);
+    QVector<ItemId> list;
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.screenId == screenId && (record.gridPos.x() > screen.maxColumn || record.gridPos.y() > screen.maxRow))
+            list<<id;
+    });
+    return list;
+}
+
+void LayoutEngine::setItemMetaPos(int screenId, ItemId id, const QPoint &gridPos)
+{
+    // an item has one metainfo position, setting it here moves it from other screens.
+    auto &record = m_items.record(id);
+    record.metaScreenId = screenId;
+    record.metaPos = gridPos;
+}
+
+QPoint LayoutEngine::itemMetaPos(int screenId, ItemId id) const
+{
+    const auto &record = m_items.record(id);
+    if (record.metaScreenId != screenId)
+        return INVALID_POS;
+    return record.metaPos;
+}
+
+QVector<ItemId> LayoutEngine::itemsMetaPosVisibleOnScreen(int screenId) const
+{
+    QVector<ItemId> list;
+    if (!isValidScreen(screenId))
+        return list;
+
+    const auto &screen = m_screens.at(screenId);
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.metaScreenId == screenId && record.metaPos != INVALID_POS
+                && record.metaPos.x() <= screen.maxColumn && record.metaPos.y() <= screen.maxRow)
+            list<<id;
+    });
+    return list;
+}
+
+QVector<ItemId> LayoutEngine::itemsMetaPosOutOfScreen(int screenId) const
+{
+    const auto &screen = m_screens.at(screenId);
+    QVector<ItemId> list;
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.metaScreenId != screenId)
+            return;
+        if (!screen.valid || record.metaPos.x() > screen.maxColumn || record.metaPos.y() > screen.maxRow)
+            list<<id;
+    });
+    return list;
+}
+
+QPoint LayoutEngine::gridPosFromGlobalPosition(int screenId, const QPoint &pos) const
+{
+    // related to the grid origin, which is the top left of the geometry without panel margins.
+    const auto &screen = m_screens.at(screenId);
+    auto relatedPos = pos - screen.area.topLeft();
+    if (!screen.valid || relatedPos.x() < 0 || relatedPos.y() < 0
+            || relatedPos.x() >= screen.area.width() || relatedPos.y() >= screen.area.height()) {
+        return INVALID_POS;
+    }
+    return QPoint(relatedPos.x()/screen.gridSize.width(), relatedPos.y()/screen.gridSize.height());
+}
+
+QPoint LayoutEngine::globalPositionFromGridPos(int screenId, const QPoint &gridPos) const
+{
+    const auto &screen = m_screens.at(screenId);
+    return QPoint(gridPos.x() * screen.gridSize.width(), gridPos.y() * screen.gridSize.height()) + screen.area.topLeft();
+}
+
+QRect LayoutEngine::gridRectFromGlobalRect(int screenId, const QRect &rect) const
+{
+    const auto &screen = m_screens.at(screenId);
+    auto relatedRect = rect.intersected(screen.area).translated(-screen.area.topLeft());
+    if (relatedRect.isEmpty() || screen.cells.isEmpty()) {
+        return QRect();
+    }
+
+    int left = relatedRect.left()/screen.gridSize.width();
+    int top = relatedRect.top()/screen.gridSize.height();
+    int right = qMin(relatedRect.right()/screen.gridSize.width(), screen.maxColumn);
+    int bottom = qMin(relatedRect.bottom()/screen.gridSize.height(), screen.maxRow);
+    if (left > right || top > bottom) {
+        return QRect();
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+QPoint LayoutEngine::itemGlobalPosition(ItemId id) const
+{
+    const auto &record = m_items.record(id);
+    if (!isValidScreen(record.screenId))
+        return INVALID_POS;
+    return globalPositionFromGridPos(record.screenId, record.gridPos);
+}
+
+QRect LayoutEngine::itemGlobalRect(ItemId id) const
+{
+    const auto &record = m_items.record(id);
+    if (!isValidScreen(record.screenId))
+        return QRect();
+    return QRect(globalPositionFromGridPos(record.screenId, record.gridPos), m_screens.at(record.screenId).gridSize);
+}
+
+ItemId LayoutEngine::itemAtGlobalPosition(const QPoint &pos, int padding) const
+{
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        if (!isValidScreen(screenId) || !m_screens.at(screenId).area.contains(pos))
+            continue;
+
+        auto gridPos = gridPosFromGlobalPosition(screenId, pos);
+        if (gridPos == INVALID_POS)
+            continue;
+
+        // check if pos is closed to grid border.
+        QRect visualRect(globalPositionFromGridPos(screenId, gridPos), m_screens.at(screenId).gridSize);
+        visualRect.adjust(padding, padding, -padding, -padding);
+        if (!visualRect.contains(pos))
+            continue;
+
+        auto id = itemAt(screenId, gridPos);
+        if (id != INVALID_ITEM_ID)
+            return id;
+    }
+    return INVALID_ITEM_ID;
+}
+
+QVector<ItemId> LayoutEngine::itemsInGlobalRect(const QRect &rect, int padding) const
+{
+    // only look at the cells under rect.
+    QVector<ItemId> list;
+    int cellsScanned = 0;
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        if (!isValidScreen(screenId))
+            continue;
+
+        auto cells = gridRectFromGlobalRect(screenId, rect);
+        cellsScanned += cells.width() * cells.height();
+        for (int x = cells.left(); x <= cells.right(); x++) {
+            for (int y = cells.top(); y <= cells.bottom(); y++) {
+                QPoint gridPos(x, y);
+                auto id = itemAt(screenId, gridPos);
+                if (id == INVALID_ITEM_ID)
+                    continue;
+
+                QRect itemRect(globalPositionFromGridPos(screenId, gridPos), m_screens.at(screenId).gridSize);
+                itemRect.adjust(padding, padding, -padding, -padding);
+                if (rect.intersects(itemRect))
+                    list<<id;
+            }
+        }
+    }
+    TRACE_COUNTER("cells scanned", cellsScanned);
+    return list;
+}
+
+void LayoutEngine::insertItems(const QVector<ItemId> &ids)
+{
+    qint64 cellsScanned = m_cellsScanned;
+    m_itemsPosesCount.reserve(m_itemsPosesCount.count() + ids.count());
+
+    // items with a free metainfo postion are placed directly, float items give way to them.
+    QVector<ItemId> itemsNeedBeLayouted;
+    for (auto id : ids) {
+        m_items.record(id).setFlag(ItemRecord::InModel);
+        bool placed = false;
+        int screenId = m_items.record(id).metaScreenId;
+        if (isValidScreen(screenId)) {
+            auto metaGridPos = m_items.record(id).metaPos;
+            auto occupant = itemAt(screenId, metaGridPos);
+            if (occupant != INVALID_ITEM_ID && occupant != id && m_items.record(occupant).testFlag(ItemRecord::Float)) {
+                takeItem(occupant);
+                itemsNeedBeLayouted<<occupant;
+            }
+            if (setItemGridPos(screenId, id, metaGridPos)) {
+                setItemCachedPos(id, itemGlobalPosition(id));
+                placed = true;
+            }
+        }
+
+        if (!placed) {
+            // add item to float items.
+            m_items.record(id).setFlag(ItemRecord::Float);
+            itemsNeedBeLayouted<<id;
+        }
+    }
+
+    // one sweep over the free cells of all screens, in screen order.
+    int placed = 0;
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        if (placed == itemsNeedBeLayouted.count())
+            break;
+        if (!isValidScreen(screenId))
+            continue;
+        int from = placed;
+        placed = placeItems(screenId, itemsNeedBeLayouted, from);
+        for (int i = from; i < placed; i++) {
+            auto id = itemsNeedBeLayouted.at(i);
+            setItemCachedPos(id, itemGlobalPosition(id));
+        }
+    }
+    for (int i = placed; i < itemsNeedBeLayouted.count(); i++) {
+        // no place to place items
+        removeItemCachedPos(itemsNeedBeLayouted.at(i));
+        m_itemsOutOfGrid<<itemsNeedBeLayouted.at(i);
+    }
+    TRACE_COUNTER("cells scanned", m_cellsScanned - cellsScanned);
+}
+
+void LayoutEngine::removeItems(const QVector<ItemId> &ids)
+{
+    // remove all items, and remember the cells they leave.
+    QVector<QPair<int, QPoint>> holes;
+    for (auto id : ids) {
+        m_itemsOutOfGrid.remove(id);
+        removeItemCachedPos(id);
+
+        auto &record = m_items.record(id);
+        if (isValidScreen(record.screenId) && cellIndex(record.screenId, record.gridPos) >= 0)
+            holes<<qMakePair(int(record.screenId), record.gridPos);
+        takeItem(id);
+
+        // metainfo is kept for the uri, the item may come back.
+        if (record.hasMetaPos()) {
+            record.index = QPersistentModelIndex();
+            record.flags = 0;
+        } else {
+            m_items.release(id);
+        }
+    }
+
+    // 浮动元素补位，不重排全部浮动元素
+    fillHolesWithFloatItems(holes);
+
+    // there are at most as many free cells as holes for items out of grid.
+    // taken in id order, not in hash order, so that a replayed session lays out the same.
+    if (holes.isEmpty() || m_itemsOutOfGrid.isEmpty())
+        return;
+    QVector<ItemId> itemsOutOfGrid;
+    itemsOutOfGrid.reserve(m_itemsOutOfGrid.count());
+    for (auto id : m_itemsOutOfGrid) {
+        itemsOutOfGrid<<id;
+    }
+    std::sort(itemsOutOfGrid.begin(), itemsOutOfGrid.end());
+    if (itemsOutOfGrid.count() > holes.count())
+        itemsOutOfGrid.resize(holes.count());
+    relayoutItems(itemsOutOfGrid);
+}
+
+void LayoutEngine::relayoutItems(const QVector<ItemId> &ids)
+{
+    qint64 cellsScanned = m_cellsScanned;
+    for (auto id : ids) {
+        takeItem(id);
+    }
+
+    for (auto id : ids) {
+        bool placed = false;
+        for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+            if (!isValidScreen(screenId))
+                continue;
+            if (placeItem(screenId, id) != INVALID_POS) {
+                setItemCachedPos(id, itemGlobalPosition(id));
+                placed = true;
+                break;
+            }
+        }
+
+        if (placed) {
+            m_itemsOutOfGrid.remove(id);
+        } else {
+            // no place to place items
+            removeItemCachedPos(id);
+            m_itemsOutOfGrid<<id;
+        }
+    }
+    TRACE_COUNTER("cells scanned", m_cellsScanned - cellsScanned);
+}
+
+void LayoutEngine::relayoutScreens(const QVector<int> &screenIds)
+{
+    QVector<ItemId> itemsNeedBeRelayouted;
+    for (auto screenId : screenIds) {
+        auto items = itemsOnScreen(screenId);
+        for (auto id : items) {
+            takeItem(id);
+        }
+        itemsNeedBeRelayouted<<items;
+    }
+
+    // 优先排列界内的有metainfo的图标
+    QSet<ItemId> itemsRestored;
+    for (auto screenId : screenIds) {
+        auto itemsMetaPosOnScreen = itemsMetaPosVisibleOnScreen(screenId);
+        for (auto id : itemsMetaPosOnScreen) {
+            if (!m_items.record(id).testFlag(ItemRecord::InModel) || itemsRestored.contains(id))
+                continue;
+
+            // keep grid and cached position in sync, so that hit test agrees with painting.
+            if (setItemGridPos(screenId, id, m_items.record(id).metaPos)) {
+                setItemCachedPos(id, itemGlobalPosition(id));
+                itemsRestored<<id;
+            } else {
+                itemsNeedBeRelayouted<<id;
+            }
+        }
+    }
+
+    QVector<ItemId> items;
+    for (auto id : itemsNeedBeRelayouted) {
+        if (!itemsRestored.contains(id)) {
+            items<<id;
+            itemsRestored<<id;
+        }
+    }
+    // sort?
+    relayoutItems(items);
+}
+
+bool LayoutEngine::moveItem(ItemId id, const QPoint &globalPos)
+{
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        if (!isValidScreen(screenId))
+            continue;
+        auto gridPos = gridPosFromGlobalPosition(screenId, globalPos);
+        if (gridPos == INVALID_POS)
+            continue;
+        // the item leaves its former screen by itself.
+        if (setItemGridPos(screenId, id, gridPos)) {
+            setItemCachedPos(id, itemGlobalPosition(id));
+            return true;
+        }
+    }
+    return false;
+}
+
+QVector<ItemId> LayoutEngine::dropItems(const QVector<ItemId> &ids, const QPoint &offset)
+{
+    // 计算全体偏移量，验证越界和重叠图标，重新排序
+    QVector<QPoint> targets;
+    targets.reserve(ids.count());
+    for (auto id : ids) {
+        const auto &record = m_items.record(id);
+        int screenId = isValidScreen(record.screenId)? record.screenId: 0;
+        auto gridSize = screenId < m_screens.count()? m_screens.at(screenId).gridSize: QSize();
+        targets<<QRect(record.cachedPos, gridSize).translated(offset).center();
+    }
+    // all items leave their cells first, so that they can swap or shift into each other's cells.
+    for (auto id : ids) {
+        takeItem(id);
+    }
+
+    QVector<ItemId> moved;
+    QVector<ItemId> itemsNeedBeRelayouted;
+    for (int i = 0; i < ids.count(); i++) {
+        auto id = ids.at(i);
+        bool successed = false;
+        for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+            if (!isValidScreen(screenId))
+                continue;
+            auto gridPos = gridPosFromGlobalPosition(screenId, targets.at(i));
+            if (gridPos != INVALID_POS && setItemGridPos(screenId, id, gridPos)) {
+                setItemMetaPos(screenId, id, gridPos);
+                setItemCachedPos(id, itemGlobalPosition(id));
+                moved<<id;
+                successed = true;
+                break;
+            }
+        }
+        if (!successed) {
+            //排列失败，这个元素被列为浮动元素
+            itemsNeedBeRelayouted<<id;
+        }
+    }
+    relayoutItems(itemsNeedBeRelayouted);
+    return moved;
+}
+
+QVector<ItemId> LayoutEngine::confirmPositions()
+{
+    //非越界元素的确认，越界元素不应该保存位置
+    QVector<ItemId> confirmed;
+    for (auto id : visibleItems()) {
+        //检查当前位置是否有重叠，如果有，则不确认
+        if (isItemOverlapped(id))
+            continue;
+
+        //从浮动元素中排除，设置metainfo
+        auto &record = m_items.record(id);
+        record.setFlag(ItemRecord::Float, false);
+        record.metaScreenId = record.screenId;
+        record.metaPos = record.gridPos;
+        confirmed<<id;
+    }
+    return confirmed;
+}
+
+void LayoutEngine::resetItems()
+{
+    QVector<ItemId> unusedItems;
+    m_items.forEach([&](ItemId id, ItemRecord &record) {
+        if (!record.hasMetaPos()) {
+            unusedItems<<id;
+            return;
+        }
+        ItemRecord metaOnly;
+        metaOnly.uri = record.uri;
+        metaOnly.metaScreenId = record.metaScreenId;
+        metaOnly.metaPos = record.metaPos;
+        record = metaOnly;
+    });
+    for (auto id : unusedItems) {
+        m_items.release(id);
+    }
+    m_itemsOutOfGrid.clear();
+    m_itemsPosesCount.clear();
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        clearScreen(screenId);
+    }
+}
+
+void LayoutEngine::clearMetaPoses()
+{
+    QVector<ItemId> unusedItems;
+    m_items.forEach([&](ItemId id, ItemRecord &record) {
+        if (!record.testFlag(ItemRecord::InModel)) {
+            unusedItems<<id;
+            return;
+        }
+        record.metaScreenId = -1;
+        record.metaPos = INVALID_POS;
+    });
+    for (auto id : unusedItems) {
+        m_items.release(id);
+    }
+}
+
+bool LayoutEngine::isItemOverlapped(ItemId id) const
+{
+    const auto &record = m_items.record(id);
+    if (!record.testFlag(ItemRecord::CachedPos))
+        return false;
+    return m_itemsPosesCount.value(posKey(record.cachedPos)) > 1;
+}
+
+QVector<ItemId> LayoutEngine::visibleItems() const
+{
+    QVector<ItemId> items;
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        items<<itemsVisibleOnScreen(screenId);
+    }
+    return items;
+}
+
+bool LayoutEngine::isConsistent() const
+{
+    for (int screenId = 0; screenId < m_screens.count(); screenId++) {
+        const auto &screen = m_screens.at(screenId);
+        if (screen.cells.count() != (screen.maxColumn + 1) * (screen.maxRow + 1))
+            return false;
+        for (int index = 0; index < screen.cells.count(); index++) {
+            auto id = screen.cells.at(index);
+            if (id == INVALID_ITEM_ID) {
+                if (index < screen.firstFreeCell)
+                    return false;
+                continue;
+            }
+            if (!m_items.isValid(id) || m_items.record(id).screenId != screenId
+                    || cellIndex(screenId, m_items.record(id).gridPos) != index)
+                return false;
+        }
+    }
+
+    bool consistent = true;
+    QHash<quint64, int> posesCount;
+    m_items.forEach([&](ItemId id, const ItemRecord &record) {
+        if (record.screenId >= 0) {
+            int index = cellIndex(record.screenId, record.gridPos);
+            if (index >= 0 && m_screens.at(record.screenId).cells.at(index) != id)
+                consistent = false;
+            if (m_itemsOutOfGrid.contains(id))
+                consistent = false;
+        }
+        if (record.testFlag(ItemRecord::CachedPos))
+            posesCount[posKey(record.cachedPos)]++;
+    });
+    return consistent && posesCount == m_itemsPosesCount;
+}
+
+quint64 LayoutEngine::posKey(const QPoint &pos)
+{
+    return (quint64(quint32(pos.x())) << 32) | quint32(pos.y());
+}
+
+void LayoutEngine::setItemCachedPos(ItemId id, const QPoint &pos)
+{
+    auto &record = m_items.record(id);
+    if (record.testFlag(ItemRecord::CachedPos)) {
+        if (record.cachedPos == pos)
+            return;
+        auto countIt = m_itemsPosesCount.find(posKey(record.cachedPos));
+        if (--countIt.value() == 0)
+            m_itemsPosesCount.erase(countIt);
+    } else {
+        record.setFlag(ItemRecord::CachedPos);
+    }
+    record.cachedPos = pos;
+    m_itemsPosesCount[posKey(pos)]++;
+}
+
+void LayoutEngine::removeItemCachedPos(ItemId id)
+{
+    auto &record = m_items.record(id);
+    if (!record.testFlag(ItemRecord::CachedPos))
+        return;
+
+    auto countIt = m_itemsPosesCount.find(posKey(record.cachedPos));
+    if (--countIt.value() == 0)
+        m_itemsPosesCount.erase(countIt);
+    record.setFlag(ItemRecord::CachedPos, false);
+}
+
+void LayoutEngine::fillHolesWithFloatItems(const QVector<QPair<int, QPoint>> &holes)
+{
+    // layout order is screen order, then column major cell order. each hole takes the
+    // last float item after it, so float items stay packed as relayoutItems() does.
+    QVector<QPair<int, int>> sortedHoles; //(screen id, cell index)
+    for (auto hole : holes) {
+        sortedHoles<<qMakePair(hole.first, cellIndex(hole.first, hole.second));
+    }
+    std::sort(sortedHoles.begin(), sortedHoles.end());
+
+    // cursor only moves backward, so all holes cost one scan at most.
+    int screenId = m_screens.count() - 1;
+    int cell = screenId >= 0? m_screens.last().cells.count() - 1: -1;
+    for (auto hole : sortedHoles) {
+        int floatItemScreen = -1;
+        ItemId floatItem = INVALID_ITEM_ID;
+        QPoint floatItemGridPos;
+        while (screenId > hole.first || (screenId == hole.first && cell > hole.second)) {
+            const auto &screen = m_screens.at(screenId);
+            if (cell < 0 || !screen.valid) {
+                screenId--;
+                if (screenId >= 0) {
+                    cell = m_screens.at(screenId).cells.count() - 1;
+                }
+                continue;
+            }
+
+            auto gridPos = QPoint(cell / (screen.maxRow + 1), cell % (screen.maxRow + 1));
+            cell--;
+            auto id = itemAt(screenId, gridPos);
+            if (id != INVALID_ITEM_ID && m_items.record(id).testFlag(ItemRecord::Float)) {
+                floatItemScreen = screenId;
+                floatItem = id;
+                floatItemGridPos = gridPos;
+                break;
+            }
+        }
+
+        if (floatItemScreen < 0) {
+            // no float item after this hole, and neither after the next ones.
+            break;
+        }
+
+        const auto &holeScreen = m_screens.at(hole.first);
+        auto holeGridPos = QPoint(hole.second / (holeScreen.maxRow + 1), hole.second % (holeScreen.maxRow + 1));
+        takeItem(floatItem);
+        if (setItemGridPos(hole.first, floatItem, holeGridPos)) {
+            setItemCachedPos(floatItem, itemGlobalPosition(floatItem));
+        } else {
+            setItemGridPos(floatItemScreen, floatItem, floatItemGridPos);
+        }
+    }
+}
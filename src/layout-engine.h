@@ -0,0 +1,113 @@
+#ifndef LAYOUTENGINE_H
+#define LAYOUTENGINE_H
+
+#include "item-table.h"
+#include <QRect>
+#include <QMargins>
+#include <QSize>
+#include <QSet>
+#include <QPair>
+
+// grid of one screen.
+struct LayoutScreen
+{
+    QRect geometry; //screen geometry
+    QMargins margins; //panel margins
+    QRect area; //geometry without margins, origin of the grid
+    QSize gridSize = QSize(100, 150);
+    bool valid = true;
+    int maxRow = 0;
+    int maxColumn = 0;
+
+    // column major occupancy of the grid, (maxColumn + 1) * (maxRow + 1) cells.
+    // INVALID_ITEM_ID means the cell is free.
+    QVector<ItemId> cells;
+    // all cells before this index are taken, free cells are searched from here.
+    int firstFreeCell = 0;
+};
+
+// placement, relayout, overlap and metainfo logic of desktop items.
+// it knows nothing about widgets, QScreen or models, only screen rects, margins and grid sizes,
+// so that it can be driven and measured without a display. Screen and DesktopView adapt it to Qt.
+// screen ids are indexes of screens, in the order they were added.
+class LayoutEngine
+{
+public:
+    // screens
+    int addScreen(const QRect &geometry, const QMargins &margins, const QSize &gridSize);
+    int screenCount() const {return m_screens.count();}
+    const LayoutScreen &screen(int screenId) const {return m_screens.at(screenId);}
+    bool isValidScreen(int screenId) const;
+    void setScreenGeometry(int screenId, const QRect &geometry, const QMargins &margins, const QSize &gridSize); //rebuild grid, items are not moved
+    void setScreenValid(int screenId, bool valid);
+    void swapScreens(int screenId1, int screenId2); //items and metainfo stay with their grid
+
+    ItemTable &items() {return m_items;}
+    const ItemTable &items() const {return m_items;}
+
+    // grid of one screen
+    int cellIndex(int screenId, const QPoint &gridPos) const; // -1 if gridPos is out of grid
+    ItemId itemAt(int screenId, const QPoint &gridPos) const;
+    bool isGridPosFree(int screenId, const QPoint &gridPos) const;
+    QPoint placeItem(int screenId, ItemId id, const QPoint &lastPos = QPoint()); // place into the first free cell from lastPos, (-1, -1) if failed
+    int placeItems(int screenId, const QVector<ItemId> &ids, int from = 0); // return the index of the first unplaced id
+    bool setItemGridPos(int screenId, ItemId id, const QPoint &gridPos);
+    QPoint itemGridPos(int screenId, ItemId id) const;
+    void takeItem(ItemId id); //remove item from its screen
+    void clearScreen(int screenId);
+
+    QVector<ItemId> itemsOnScreen(int screenId) const;
+    QVector<ItemId> itemsVisibleOnScreen(int screenId) const;
+    QVector<ItemId> itemsOutOfScreen(int screenId) const;
+
+    void setItemMetaPos(int screenId, ItemId id, const QPoint &gridPos);
+    QPoint itemMetaPos(int screenId, ItemId id) const;
+    QVector<ItemId> itemsMetaPosVisibleOnScreen(int screenId) const;
+    QVector<ItemId> itemsMetaPosOutOfScreen(int screenId) const;
+
+    // positions, global positions are in the coordinates of screen geometries
+    QPoint gridPosFromGlobalPosition(int screenId, const QPoint &pos) const;
+    QPoint globalPositionFromGridPos(int screenId, const QPoint &gridPos) const;
+    QRect gridRectFromGlobalRect(int screenId, const QRect &rect) const; // cells covered by rect, clamped to grid. null if none
+    QPoint itemGlobalPosition(ItemId id) const;
+    QRect itemGlobalRect(ItemId id) const;
+    ItemId itemAtGlobalPosition(const QPoint &pos, int padding = 0) const;
+    QVector<ItemId> itemsInGlobalRect(const QRect &rect, int padding = 0) const;
+
+    // layout of all screens
+    void insertItems(const QVector<ItemId> &ids); //items with a free metainfo position go there, the others float
+    void removeItems(const QVector<ItemId> &ids); //float items fill the holes
+    void relayoutItems(const QVector<ItemId> &ids);
+    void relayoutScreens(const QVector<int> &screenIds); //after geometry or grid changed, metainfo is not changed
+    bool moveItem(ItemId id, const QPoint &globalPos);
+    QVector<ItemId> dropItems(const QVector<ItemId> &ids, const QPoint &offset); //return items got a new metainfo
+    QVector<ItemId> confirmPositions(); //not overlapped visible items take their position as metainfo, return them
+    void resetItems(); //only metainfo is kept
+    void clearMetaPoses(); //forget all metainfo, records of items not in model are released
+
+    bool isItemOverlapped(ItemId id) const;
+    QVector<ItemId> visibleItems() const;
+    const QSet<ItemId> &itemsOutOfGrid() const {return m_itemsOutOfGrid;}
+
+    bool isConsistent() const; //cells, records and counters agree with each other
+
+private:
+    void insertItem(int screenId, ItemId id, const QPoint &gridPos);
+    void occupyCell(int screenId, ItemId id, const QPoint &gridPos);
+    void releaseCell(int screenId, const QPoint &gridPos);
+    void rebuildCells(int screenId);
+    void recalculateGrid(int screenId);
+
+    static quint64 posKey(const QPoint &pos);
+    void setItemCachedPos(ItemId id, const QPoint &pos);
+    void removeItemCachedPos(ItemId id);
+    void fillHolesWithFloatItems(const QVector<QPair<int, QPoint>> &holes);
+
+    QVector<LayoutScreen> m_screens;
+    ItemTable m_items;
+    QSet<ItemId> m_itemsOutOfGrid; //所有屏幕都放不下的元素
+    QHash<quint64, int> m_itemsPosesCount; //每个全局位置上的元素数量，用于判断重叠
+    qint64 m_cellsScanned = 0; //by placeItem(), traced once per operation
+};
+
+#endif // LAYOUTENGINE_H
@@ -12,16 +12,12 @@ Screen::Screen(QScreen *screen, QSize gridSize, QObject *parent) : QObject(paren
         return;
     }
 
+    // the grid is created when view adds this screen into its layout engine.
     m_screen = screen;
-    m_geometry = screen->geometry();
-    m_geometry.adjust(m_panelMargins.left(), m_panelMargins.top(), -m_panelMargins.right(), -m_panelMargins.bottom());
-    m_gridSize = gridSize;
-    recalculateGrid();
+    m_pendingScreenGeometry = screen->geometry();
+    m_pendingGridSize = gridSize;
     connect(screen, &QScreen::geometryChanged, this, &Screen::onScreenGeometryChanged);
-    connect(screen, &QScreen::destroyed, this, [=](){
-        m_screen = nullptr;
-        Q_EMIT screenVisibleChanged(false);
-    });
+    connect(screen, &QScreen::destroyed, this, &Screen::unbindScreen);
 }
 
 bool Screen::isValidScreen()
@@ -31,21 +27,20 @@ bool Screen::isValidScreen()
 
 int Screen::maxRow() const
 {
-    return m_maxRow;
+    return m_layout->screen(m_id).maxRow;
 }
 
 int Screen::maxColumn() const
 {
-    return m_maxColumn;
+    return m_layout->screen(m_id).maxColumn;
 }
 
 void Screen::onScreenGeometryChanged(const QRect &geometry)
 {
     if (!geometry.isEmpty()) {
-        m_geometry = geometry;
-        m_geometry.adjust(m_panelMargins.left(), m_panelMargins.top(), -m_panelMargins.right(), -m_panelMargins.bottom());
-        recalculateGrid();
-        getView()->handleScreenChanged(this);
+        m_pendingScreenGeometry = geometry;
+        requestLayout();
+        Q_EMIT geometryChanged(geometry);
     }
 }
 
@@ -56,31 +51,35 @@ void Screen::onScreenGridSizeChanged(const QSize &gridSize)
         return;
     }
 
-    m_gridSize = gridSize;
-    recalculateGrid();
+    m_pendingGridSize = gridSize;
+    requestLayout();
 }
 
 void Screen::setPanelMargins(const QMargins &margins)
 {
-    m_panelMargins = margins;
-    m_geometry.adjust(margins.left(), margins.top(), -margins.right(), -margins.bottom());
-    recalculateGrid();
-
-    getView()->handleScreenChanged(this);
+    m_pendingPanelMargins = margins;
+    requestLayout();
+    Q_EMIT panelMarginsChanged(margins);
 }
 
-void Screen::recalculateGrid()
+void Screen::requestLayout()
 {
-    m_maxColumn = m_geometry.width()/m_gridSize.width();
-    m_maxRow = m_geometry.height()/m_gridSize.height();
-    if (/*m_geometry.width() % m_gridSize.width() == 0 && */m_maxColumn > 0) {
-        m_maxColumn--;
-    }
-    if (/*m_geometry.height() % m_gridSize.height() == 0 && */m_maxRow > 0) {
-        m_maxRow--;
+    // 几何/网格/边距的变化先记下来，由view在下一轮事件循环中统一应用
+    if (auto view = getView()) {
+        view->scheduleScreenLayout(this);
+    } else {
+        applyPendingLayout();
     }
 }
 
+void Screen::applyPendingLayout()
+{
+    if (!m_layout)
+        return;
+    m_layout->setScreenGeometry(m_id, m_pendingScreenGeometry, m_pendingPanelMargins, m_pendingGridSize);
+    m_layout->setScreenValid(m_id, m_screen);
+}
+
 DesktopView *Screen::getView()
 {
     return qobject_cast<DesktopView *>(parent());
@@ -93,86 +92,57 @@ QString Screen::getIndexUri(const QModelIndex &index)
 
 void Screen::clearItems()
 {
-    m_items.clear();
+    m_layout->clearScreen(m_id);
 }
 
-QRect Screen::getGeometry() const
+ItemId Screen::getItemFromGridPos(const QPoint &pos) const
 {
-    return m_geometry;
+    return m_layout->itemAt(m_id, pos);
 }
 
-QStringList Screen::getAllItemsOnScreen()
+bool Screen::isGridPosFree(const QPoint &pos) const
 {
-    return m_items.keys();
+    return m_layout->isGridPosFree(m_id, pos);
 }
 
-QStringList Screen::getItemsOutOfScreen()
+QRect Screen::getGeometry() const
 {
-    QStringList list;
-    for (auto uri : m_items.keys()) {
-        auto gridPos = m_items.value(uri);
-        if (gridPos.x() > m_maxColumn || gridPos.y() > m_maxRow) {
-            list<<uri;
-        }
-    }
-
-    return list;
+    return m_layout->screen(m_id).area;
 }
 
-QStringList Screen::getItemsVisibleOnScreen()
+QVector<ItemId> Screen::getAllItemsOnScreen()
 {
-    if (!isValidScreen())
-        return QStringList();
-    QStringList list;
-    for (auto uri : m_items.keys()) {
-        auto gridPos = m_items.value(uri);
-        if (gridPos.x() <= m_maxColumn && gridPos.y() <= m_maxRow) {
-            list<<uri;
-        }
-    }
-
-    return list;
+    return m_layout->itemsOnScreen(m_id);
 }
 
-void Screen::setItemMetaInfoGridPos(const QString &uri, const QPoint &pos)
+QVector<ItemId> Screen::getItemsOutOfScreen()
 {
-    m_itemsMetaPoses.remove(uri);
-    m_itemsMetaPoses.insert(uri, pos);
+    return m_layout->itemsOutOfScreen(m_id);
 }
 
-QPoint Screen::getItemMetaInfoGridPos(const QString &uri)
+QVector<ItemId> Screen::getItemsVisibleOnScreen()
 {
-    return m_itemsMetaPoses.value(uri, INVALID_POS);
+    return m_layout->itemsVisibleOnScreen(m_id);
 }
 
-QStringList Screen::getItemsMetaGridPosOutOfScreen()
+void Screen::setItemMetaInfoGridPos(ItemId id, const QPoint &pos)
 {
-    QStringList list;
-    if (!m_screen)
-        return m_itemsMetaPoses.keys();
-    for (auto uri : m_itemsMetaPoses.keys()) {
-        auto gridPos = m_itemsMetaPoses.value(uri);
-        if (gridPos.x() > m_maxColumn || gridPos.y() > m_maxRow) {
-            list<<uri;
-        }
-    }
+    m_layout->setItemMetaPos(m_id, id, pos);
+}
 
-    return list;
+QPoint Screen::getItemMetaInfoGridPos(ItemId id) const
+{
+    return m_layout->itemMetaPos(m_id, id);
 }
 
-QStringList Screen::getItemMetaGridPosVisibleOnScreen()
+QVector<ItemId> Screen::getItemsMetaGridPosOutOfScreen()
 {
-    QStringList list;
-    if (m_screen) {
-        for (auto uri : m_itemsMetaPoses.keys()) {
-            auto gridPos = m_itemsMetaPoses.value(uri);
-            if (gridPos.x() <= m_maxColumn && gridPos.y() <= m_maxRow && gridPos != INVALID_POS) {
-                list<<uri;
-            }
-        }
-    }
+    return m_layout->itemsMetaPosOutOfScreen(m_id);
+}
 
-    return list;
+QVector<ItemId> Screen::getItemMetaGridPosVisibleOnScreen()
+{
+    return m_layout->itemsMetaPosVisibleOnScreen(m_id);
 }
 
 QScreen *Screen::getScreen() const
@@ -180,59 +150,33 @@ QScreen *Screen::getScreen() const
     return m_screen;
 }
 
-QPoint Screen::placeItem(const QString &uri, QPoint lastPos)
+QPoint Screen::placeItem(ItemId id, QPoint lastPos)
 {
-    // remove current pos
-    if (m_items.value(uri, INVALID_POS) != INVALID_POS) {
-        m_items.remove(uri);
-    }
+    return m_layout->placeItem(m_id, id, lastPos);
+}
 
-    QPoint pos = INVALID_POS;
-    int x = lastPos.x();
-    int y = lastPos.y();
-    while (x <= m_maxColumn && y <= m_maxRow) {
-        // check if there is an index in this grid pos.
-        auto tmp = QPoint(x, y);
-        if (m_items.key(tmp).isEmpty()) {
-            pos.setX(x);
-            pos.setY(y);
-            // FIXME:
-            m_items.insert(uri, pos);
-            return pos;
-        } else {
-            if (y + 1 <= m_maxRow) {
-                y++;
-            } else {
-                y = 0;
-                if (x + 1 <= m_maxColumn) {
-                    x++;
-                } else {
-                    // out of grid, break
-                    break;
-                }
-            }
-            continue;
-        }
-    }
-    return pos;
+int Screen::placeItems(const QVector<ItemId> &ids, int from)
+{
+    return m_layout->placeItems(m_id, ids, from);
 }
 
-QPoint Screen::itemGridPos(const QString &uri)
+QPoint Screen::itemGridPos(ItemId id) const
 {
-    return m_items.value(uri, INVALID_POS);
+    return m_layout->itemGridPos(m_id, id);
 }
 
-void Screen::makeItemGridPosInvalid(const QString &uri)
+void Screen::makeItemGridPosInvalid(ItemId id)
 {
-    m_items.remove(uri);
+    if (m_layout->items().record(id).screenId == m_id)
+        m_layout->takeItem(id);
 }
 
-bool Screen::isItemOutOfGrid(const QString &uri)
+bool Screen::isItemOutOfGrid(ItemId id)
 {
-    auto pos = m_items.value(uri);
+    auto pos = itemGridPos(id);
     if (pos == INVALID_POS) {
         return true;
-    } else if (pos.x() > m_maxColumn || pos.y() > m_maxRow) {
+    } else if (pos.x() > maxColumn() || pos.y() > maxRow()) {
         return false;
     }
     return true;
@@ -240,111 +184,84 @@ bool Screen::isItemOutOfGrid(const QString &uri)
 
 QPoint Screen::gridPosFromRelatedPosition(const QPoint &pos)
 {
-    if (!m_screen->geometry().contains(pos)) {
-        return INVALID_POS;
-    }
-    int x = pos.x()/m_gridSize.width();
-    int y = pos.y()/m_gridSize.height();
-    return QPoint(x, y);
+    // related to the grid origin, which is the top left of the geometry without panel margins.
+    return gridPosFromGlobalPosition(pos + getGeometry().topLeft());
 }
 
 QPoint Screen::gridPosFromGlobalPosition(const QPoint &pos)
 {
-    auto relatedPos = pos - m_screen->geometry().topLeft();
-    return gridPosFromRelatedPosition(relatedPos);
+    return m_layout->gridPosFromGlobalPosition(m_id, pos);
 }
 
 QPoint Screen::relatedPositionFromGridPos(const QPoint &pos)
 {
-    return QPoint(pos.x() * m_gridSize.width(), pos.y() * m_gridSize.height());
+    return globalPositionFromGridPos(pos) - getGeometry().topLeft();
 }
 
 QPoint Screen::globalPositionFromGridPos(const QPoint &pos)
 {
-    return relatedPositionFromGridPos(pos) + m_geometry.topLeft();
+    return m_layout->globalPositionFromGridPos(m_id, pos);
 }
 
-QPoint Screen::getItemRelatedPosition(const QString &uri)
+QRect Screen::gridRectFromGlobalRect(const QRect &rect) const
 {
-    if (!m_screen)
-        return INVALID_POS;
+    return m_layout->gridRectFromGlobalRect(m_id, rect);
+}
 
-    auto gridPos = m_items.value(uri, INVALID_POS);
-    if (gridPos == INVALID_POS)
+QPoint Screen::getItemRelatedPosition(ItemId id)
+{
+    auto pos = getItemGlobalPosition(id);
+    if (pos == INVALID_POS)
         return INVALID_POS;
-    return QPoint(gridPos.x() * m_gridSize.width(), gridPos.y() * m_gridSize.height());
+    return pos - getGeometry().topLeft();
 }
 
-QPoint Screen::getItemGlobalPosition(const QString &uri)
+QPoint Screen::getItemGlobalPosition(ItemId id)
 {
-    if (!m_screen)
+    if (!m_screen || m_layout->items().record(id).screenId != m_id)
         return INVALID_POS;
 
-    auto gridPos = getItemRelatedPosition(uri);
-    if (gridPos == INVALID_POS) {
-        return INVALID_POS;
-    }
+    return m_layout->itemGlobalPosition(id);
+}
 
-    return getItemRelatedPosition(uri) + m_geometry.topLeft();
+ItemId Screen::getItemFromRelatedPosition(const QPoint &pos)
+{
+    return getItemFromGlobalPosition(pos + getGeometry().topLeft());
 }
 
-QString Screen::getItemFromRelatedPosition(const QPoint &pos)
+ItemId Screen::getItemFromGlobalPosition(const QPoint &pos)
 {
-    if (!m_screen) {
-        return nullptr;
-    }
     // used at indexAt(). need margins
-    int x = pos.x()/m_gridSize.width();
-    int y = pos.y()/m_gridSize.height();
-    if (x <= m_maxColumn && x >= 0 && y <= m_maxRow && y >= 0) {
-        // check if pos is closed to grid border.
-        QRect visualRect = QRect(x * m_gridSize.width(), y * m_gridSize.height(), m_gridSize.width(), m_gridSize.height());
-        visualRect.adjust(ICONVIEW_PADDING, ICONVIEW_PADDING, -ICONVIEW_PADDING, -ICONVIEW_PADDING);
-        if (!visualRect.contains(pos)) {
-            return nullptr;
-        }
-        return m_items.key(QPoint(x, y));
-    } else {
-        return nullptr;
+    auto gridPos = gridPosFromGlobalPosition(pos);
+    if (gridPos == INVALID_POS) {
+        return INVALID_ITEM_ID;
     }
-}
 
-QString Screen::getItemFromGlobalPosition(const QPoint &pos)
-{
-    if (!m_screen) {
-        return nullptr;
+    // check if pos is closed to grid border.
+    QRect visualRect = QRect(globalPositionFromGridPos(gridPos), m_layout->screen(m_id).gridSize);
+    visualRect.adjust(ICONVIEW_PADDING, ICONVIEW_PADDING, -ICONVIEW_PADDING, -ICONVIEW_PADDING);
+    if (!visualRect.contains(pos)) {
+        return INVALID_ITEM_ID;
     }
-    return getItemFromRelatedPosition(pos - m_screen->geometry().topLeft());
+    return getItemFromGridPos(gridPos);
 }
 
-bool Screen::setItemGridPos(const QString &uri, const QPoint &pos)
+bool Screen::setItemGridPos(ItemId id, const QPoint &pos)
 {
-    auto currentGridPos = m_items.value(uri);
-    if (currentGridPos == pos)
-        return true;
-
-    if (pos.x() > m_maxColumn || pos.y() > m_maxRow || pos.x() < 0 || pos.y() < 0) {
+    if (pos.x() > maxColumn() || pos.y() > maxRow() || pos.x() < 0 || pos.y() < 0) {
         qWarning()<<"invalid grid pos";
         return false;
     }
 
-    auto itemOnTargetPos = m_items.key(pos);
-    if (itemOnTargetPos.isEmpty()) {
-        m_items.insert(uri, pos);
-        return true;
-    } else {
-        return false;
-    }
+    return m_layout->setItemGridPos(m_id, id, pos);
 }
 
-bool Screen::setItemWithGlobalPos(const QString &uri, const QPoint &pos)
+bool Screen::setItemWithGlobalPos(ItemId id, const QPoint &pos)
 {
-    if (m_screen && m_screen->geometry().contains(pos)) {
-        auto relatedPos = pos - m_screen->geometry().topLeft();
-        auto gridPos = QPoint(relatedPos.x()/m_gridSize.width(), relatedPos.y()/m_gridSize.height());
-        return setItemGridPos(uri, gridPos);
-    }
-    return false;
+    auto gridPos = gridPosFromGlobalPosition(pos);
+    if (gridPos == INVALID_POS)
+        return false;
+    return m_layout->setItemGridPos(m_id, id, gridPos);
 }
 
 void Screen::rebindScreen(QScreen *screen)
@@ -359,12 +276,18 @@ void Screen::rebindScreen(QScreen *screen)
         m_screen->disconnect(m_screen, &QScreen::destroyed, this, 0);
     }
 
-    m_geometry = screen->geometry();
-    m_geometry.adjust(m_panelMargins.left(), m_panelMargins.top(), -m_panelMargins.right(), -m_panelMargins.bottom());
+    m_screen = screen;
+    m_pendingScreenGeometry = screen->geometry();
+    requestLayout();
     connect(screen, &QScreen::geometryChanged, this, &Screen::onScreenGeometryChanged);
-    connect(screen, &QScreen::destroyed, this, [=](){
-        m_screen = nullptr;
-        Q_EMIT screenVisibleChanged(false);
-    });
+    connect(screen, &QScreen::destroyed, this, &Screen::unbindScreen);
     Q_EMIT screenVisibleChanged(true);
 }
+
+void Screen::unbindScreen()
+{
+    m_screen = nullptr;
+    if (m_layout)
+        m_layout->setScreenValid(m_id, false);
+    Q_EMIT screenVisibleChanged(false);
+}
@@ -1,14 +1,18 @@
 #ifndef SCREEN_H
 #define SCREEN_H
 #include <QHash>
+#include <QVector>
 #include <QRect>
 #include <QSize>
 #include <QScreen>
 #include <QObject>
 #include <QModelIndex>
 
+#include "layout-engine.h"
+
 class DesktopView;
 
+// binds a QScreen to one screen of the view's LayoutEngine.
 class Screen : public QObject
 {
     friend class DesktopView;
@@ -21,62 +25,73 @@ public:
     int maxRow() const;
     int maxColumn() const;
 
-    QPoint placeItem(const QString &uri, QPoint lastPos = QPoint()); // try place item into an empty point, if failed return (-1, -1)
-    QPoint itemGridPos(const QString &uri);
-    bool setItemGridPos(const QString &uri, const QPoint &pos);
-    bool setItemWithGlobalPos(const QString &uri, const QPoint &pos);
-    void makeItemGridPosInvalid(const QString &uri);
+    QPoint placeItem(ItemId id, QPoint lastPos = QPoint()); // try place item into an empty point, if failed return (-1, -1)
+    int placeItems(const QVector<ItemId> &ids, int from = 0); // place ids[from...] into free cells, return the index of the first unplaced id
+    QPoint itemGridPos(ItemId id) const;
+    bool setItemGridPos(ItemId id, const QPoint &pos);
+    bool setItemWithGlobalPos(ItemId id, const QPoint &pos);
+    void makeItemGridPosInvalid(ItemId id);
 
-    bool isItemOutOfGrid(const QString &uri);
+    bool isItemOutOfGrid(ItemId id);
 
     QPoint gridPosFromRelatedPosition(const QPoint &pos);
     QPoint gridPosFromGlobalPosition(const QPoint &pos);
     QPoint relatedPositionFromGridPos(const QPoint &pos);
     QPoint globalPositionFromGridPos(const QPoint &pos);
+    QRect gridRectFromGlobalRect(const QRect &rect) const; // cells covered by rect, clamped to grid. null if none
+
+    QPoint getItemRelatedPosition(ItemId id);
+    QPoint getItemGlobalPosition(ItemId id);
+    ItemId getItemFromRelatedPosition(const QPoint &pos);
+    ItemId getItemFromGlobalPosition(const QPoint &pos);
 
-    QPoint getItemRelatedPosition(const QString &uri);
-    QPoint getItemGlobalPosition(const QString &uri);
-    QString getItemFromRelatedPosition(const QPoint &pos);
-    QString getItemFromGlobalPosition(const QPoint &pos);
+    ItemId getItemFromGridPos(const QPoint &pos) const;
+    bool isGridPosFree(const QPoint &pos) const;
 
     QScreen *getScreen() const;
     QRect getGeometry() const;
+    int screenId() const {return m_id;}
 
-    QStringList getAllItemsOnScreen();
-    QStringList getItemsOutOfScreen();
-    QStringList getItemsVisibleOnScreen();
+    QVector<ItemId> getAllItemsOnScreen();
+    QVector<ItemId> getItemsOutOfScreen();
+    QVector<ItemId> getItemsVisibleOnScreen();
 
-    void setItemMetaInfoGridPos(const QString &uri, const QPoint &pos);
-    QPoint getItemMetaInfoGridPos(const QString &uri);
-    QStringList getItemsMetaGridPosOutOfScreen();
-    QStringList getItemMetaGridPosVisibleOnScreen();
+    void setItemMetaInfoGridPos(ItemId id, const QPoint &pos);
+    QPoint getItemMetaInfoGridPos(ItemId id) const;
+    QVector<ItemId> getItemsMetaGridPosOutOfScreen();
+    QVector<ItemId> getItemMetaGridPosVisibleOnScreen();
 
 signals:
     void screenVisibleChanged(bool visible);
+    void geometryChanged(const QRect &geometry); //accepted geometry, applied in the next layout transaction
+    void panelMarginsChanged(const QMargins &margins); //applied in the next layout transaction
 
 public slots:
     void rebindScreen(QScreen *screen);
+    void unbindScreen(); //QScreen is gone, items leave this screen in the next layout transaction
     void onScreenGeometryChanged(const QRect &geometry);
     void onScreenGridSizeChanged(const QSize &gridSize);
     void setPanelMargins(const QMargins &margins);
 
 protected:
-    void recalculateGrid();
-
     DesktopView *getView();
     QString getIndexUri(const QModelIndex &index);
 
 private:
     void clearItems();
 
+    void requestLayout(); // defer geometry/grid/margins changes to the view's next layout transaction
+    void applyPendingLayout();
+
 private:
-    QRect m_geometry;
-    QSize m_gridSize;
-    QMargins m_panelMargins;
-    int m_maxRow = 0;
-    int m_maxColumn = 0;
-    QHash<QString, QPoint> m_items;
-    QHash<QString, QPoint> m_itemsMetaPoses;
+    QRect m_pendingScreenGeometry;
+    QSize m_pendingGridSize;
+    QMargins m_pendingPanelMargins;
+
+    // index in view's screens, items and metainfo refer to this screen by it.
+    int m_id = -1;
+    // owned by view, the grid of this screen lives there.
+    LayoutEngine *m_layout = nullptr;
 
     QScreen *m_screen = nullptr;
 };
@@ -0,0 +1,46 @@
+#ifndef TESTFIXTURES_H
+#define TESTFIXTURES_H
+
+#include <QStandardItem>
+#include <QIcon>
+#include <QFile>
+#include <QDir>
+
+// fixtures shared by the examples and the benchmark.
+
+// dir/file-<i>.txt
+inline QString testFilePath(const QString &dir, int i)
+{
+    return QDir(dir).filePath(QString("file-%1.txt").arg(i));
+}
+
+// empty files file-0.txt ... file-<count - 1>.txt in dir
+inline void createTestFiles(const QString &dir, int count)
+{
+    for (int i = 0; i < count; i++) {
+        QFile file(testFilePath(dir, i));
+        file.open(QIODevice::WriteOnly);
+    }
+}
+
+// file:///tmp/<name>-<i>.txt
+inline QString testItemUri(const QString &name, int i)
+{
+    return QString("file:///tmp/%1-%2.txt").arg(name).arg(i);
+}
+
+// rows for a flat model, with testItemUri() as Qt::UserRole
+inline QList<QStandardItem *> createTestItems(const QString &name, int count, const QIcon &icon = QIcon::fromTheme("text-plain"))
+{
+    QList<QStandardItem *> items;
+    items.reserve(count);
+    for (int i = 0; i < count; i++) {
+        auto uri = testItemUri(name, i);
+        auto item = new QStandardItem(icon, uri.section("/", -1));
+        item->setData(uri, Qt::UserRole);
+        items<<item;
+    }
+    return items;
+}
+
+#endif // TESTFIXTURES_H
@@ -0,0 +1,121 @@
+#include "trace.h"
+
+#ifdef DESKTOP_VIEW_TRACE
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QMutex>
+#include <QVector>
+#include <QAtomicInteger>
+#include <QDebug>
+
+// events kept per thread, 32 bytes each.
+#define RING_SIZE (1 << 16)
+
+namespace Trace {
+
+struct Ring
+{
+    QVector<Event> events = QVector<Event>(RING_SIZE);
+    QAtomicInteger<quint64> written;
+    int tid = 0;
+};
+
+// rings are never freed, a thread may exit before the trace is dumped.
+static QMutex s_ringsMutex;
+static QVector<Ring *> s_rings;
+static thread_local Ring *t_ring = nullptr;
+
+static Ring *threadRing()
+{
+    if (!t_ring) {
+        t_ring = new Ring;
+        QMutexLocker locker(&s_ringsMutex);
+        t_ring->tid = s_rings.count() + 1;
+        s_rings<<t_ring;
+    }
+    return t_ring;
+}
+
+qint64 now()
+{
+    static QElapsedTimer timer = [](){
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.nsecsElapsed();
+}
+
+void record(const char *name, char phase, qint64 ts, qint64 value)
+{
+    // only the owner thread writes, dump() reads what has been published.
+    auto ring = threadRing();
+    quint64 written = ring->written.load();
+    auto &event = ring->events[written % RING_SIZE];
+    event.name = name;
+    event.ts = ts;
+    event.value = value;
+    event.phase = phase;
+    ring->written.storeRelease(written + 1);
+}
+
+void counter(const char *name, qint64 value)
+{
+    record(name, 'C', now(), value);
+}
+
+static QByteArray microseconds(qint64 ns)
+{
+    return QByteArray::number(ns / 1000.0, 'f', 3);
+}
+
+bool dump(const QString &path)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning()<<"can not write trace"<<path;
+        return false;
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json = "{\"traceEvents\":[";
+    bool first = true;
+    QMutexLocker locker(&s_ringsMutex);
+    for (auto ring : s_rings) {
+        QByteArray tid = QByteArray::number(ring->tid);
+        quint64 written = ring->written.loadAcquire();
+        quint64 begin = written > RING_SIZE? written - RING_SIZE: 0;
+        for (quint64 i = begin; i < written; i++) {
+            const auto &event = ring->events.at(i % RING_SIZE);
+            json += first? "\n": ",\n";
+            first = false;
+            json += "{\"name\":\"" + QByteArray(event.name) + "\",\"ph\":\"" + QByteArray(1, event.phase)
+                    + "\",\"ts\":" + microseconds(event.ts) + ",\"pid\":" + pid + ",\"tid\":" + tid;
+            if (event.phase == 'X') {
+                json += ",\"dur\":" + microseconds(event.value) + "}";
+            } else {
+                json += ",\"args\":{\"value\":" + QByteArray::number(event.value) + "}}";
+            }
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    file.write(json);
+    return file.commit();
+}
+
+// declared after the rings, so it is destroyed before them.
+static struct ExitDumper
+{
+    ~ExitDumper() {
+        auto path = qgetenv("DESKTOP_VIEW_TRACE_FILE");
+        if (!path.isEmpty())
+            dump(QString::fromLocal8Bit(path));
+    }
+} s_exitDumper;
+
+}
+
+#endif // DESKTOP_VIEW_TRACE
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// scoped spans and counters of the hot paths, dumped as chrome trace_event json
+// (chrome://tracing, perfetto). everything compiles out unless DESKTOP_VIEW_TRACE
+// is defined, which is done by building with CONFIG+=trace.
+//
+// TRACE_SCOPE("paint");                   //span until the end of scope
+// TRACE_COUNTER("items painted", count);
+//
+// names must be string literals, only the pointer is recorded.
+// the trace is written to $DESKTOP_VIEW_TRACE_FILE at exit, or by Trace::dump().
+
+#ifdef DESKTOP_VIEW_TRACE
+
+#include <QtGlobal>
+
+class QString;
+
+namespace Trace {
+
+struct Event
+{
+    const char *name;
+    qint64 ts; //ns, monotonic
+    qint64 value; //duration in ns for spans, value for counters
+    char phase; //'X' span, 'C' counter
+};
+
+qint64 now();
+void record(const char *name, char phase, qint64 ts, qint64 value);
+void counter(const char *name, qint64 value);
+bool dump(const QString &path); //all threads, the oldest events are dropped when a ring is full
+
+class Span
+{
+public:
+    explicit Span(const char *name) : m_name(name), m_start(now()) {}
+    ~Span() {record(m_name, 'X', m_start, now() - m_start);}
+
+private:
+    Q_DISABLE_COPY(Span)
+    const char *m_name;
+    qint64 m_start;
+};
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_COUNTER(name, value) Trace::counter(name, value)
+
+#else
+
+// value is still referenced, so that variables only kept for counters do not warn.
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do { (void)(value); } while (0)
+
+#endif // DESKTOP_VIEW_TRACE
+
+#endif // TRACE_H
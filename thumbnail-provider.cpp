@@ -0,0 +1,192 @@
+#include "thumbnail-provider.h"
+
+#include <QRunnable>
+#include <QImageReader>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDir>
+#include <QUrl>
+#include <QThread>
+
+#define THUMBNAIL_SIZE 128
+#define PRIORITY_NORMAL 0
+#define PRIORITY_VISIBLE 1
+
+class ThumbnailJob : public QRunnable
+{
+public:
+    ThumbnailJob(ThumbnailProvider *provider, const QString &uri, qint64 modifiedTime)
+        : m_provider(provider), m_uri(uri), m_modifiedTime(modifiedTime) {}
+
+    qint64 modifiedTime() const {return m_modifiedTime;}
+
+    // used by provider in gui thread only.
+    int priority = PRIORITY_NORMAL;
+    // a newer mtime requested while this job is running, it is requeued when this job finished.
+    qint64 supersededTime = -1;
+    bool supersededPrioritized = false;
+
+    void run() override {
+        auto thumbnail = loadFromCache();
+        if (thumbnail.isNull()) {
+            thumbnail = generate();
+        }
+        QMetaObject::invokeMethod(m_provider, "onJobFinished", Qt::QueuedConnection, Q_ARG(QString, m_uri), Q_ARG(QImage, thumbnail));
+    }
+
+private:
+    QImage loadFromCache() {
+        QImage thumbnail(ThumbnailProvider::cachePath(m_uri));
+        if (thumbnail.isNull() || thumbnail.text("Thumb::MTime") != QString::number(m_modifiedTime / 1000)) {
+            return QImage();
+        }
+        return thumbnail;
+    }
+
+    QImage generate() {
+        QImageReader reader(QUrl(m_uri).toLocalFile());
+        auto size = reader.size();
+        if (!size.isValid())
+            return QImage();
+        if (size.width() > THUMBNAIL_SIZE || size.height() > THUMBNAIL_SIZE) {
+            reader.setScaledSize(size.scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio));
+        }
+        auto thumbnail = reader.read();
+        if (thumbnail.isNull())
+            return thumbnail;
+
+        thumbnail.setText("Thumb::URI", ThumbnailProvider::thumbnailUri(m_uri));
+        thumbnail.setText("Thumb::MTime", QString::number(m_modifiedTime / 1000));
+        auto path = ThumbnailProvider::cachePath(m_uri);
+        QDir().mkpath(QFileInfo(path).path());
+        QSaveFile file(path);
+        // only readable by the user, as the spec requires
+        if (file.open(QIODevice::WriteOnly) && file.setPermissions(QFileDevice::ReadOwner|QFileDevice::WriteOwner)
+                && thumbnail.save(&file, "PNG")) {
+            file.commit();
+        }
+        return thumbnail;
+    }
+
+    ThumbnailProvider *m_provider;
+    QString m_uri;
+    qint64 m_modifiedTime;
+};
+
+ThumbnailProvider::ThumbnailProvider(QObject *parent) : QObject(parent)
+{
+    // leave cores for gui and directory loading
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+}
+
+ThumbnailProvider::~ThumbnailProvider()
+{
+    cancelAll();
+    m_pool.waitForDone();
+    qDeleteAll(m_jobs);
+}
+
+bool ThumbnailProvider::canThumbnail(const QString &iconName)
+{
+    return iconName.startsWith("image-");
+}
+
+QString ThumbnailProvider::thumbnailUri(const QString &uri)
+{
+    // model uris are pretty decoded, the spec hashes the fully encoded one.
+    return QString::fromLatin1(QUrl(uri).toEncoded());
+}
+
+QString ThumbnailProvider::cachePath(const QString &uri)
+{
+    auto hash = QCryptographicHash::hash(thumbnailUri(uri).toLatin1(), QCryptographicHash::Md5).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/thumbnails/normal/" + QString::fromLatin1(hash) + ".png";
+}
+
+void ThumbnailProvider::requestThumbnail(const QString &uri, qint64 modifiedTime, bool prioritized)
+{
+    if (auto job = m_jobs.value(uri)) {
+        if (job->modifiedTime() >= modifiedTime)
+            return;
+
+        if (m_pool.tryTake(job)) {
+            // not started yet, replace it.
+            m_jobs.remove(uri);
+            delete job;
+        } else {
+            // running, it would write the thumbnail of the old mtime.
+            job->supersededTime = qMax(job->supersededTime, modifiedTime);
+            job->supersededPrioritized |= prioritized;
+            return;
+        }
+    }
+
+    auto job = new ThumbnailJob(this, uri, modifiedTime);
+    // jobs are deleted in gui thread, so that a queued job can be taken back safely.
+    job->setAutoDelete(false);
+    job->priority = prioritized? PRIORITY_VISIBLE: PRIORITY_NORMAL;
+    m_jobs.insert(uri, job);
+    m_pool.start(job, job->priority);
+}
+
+void ThumbnailProvider::prioritize(const QStringList &uris)
+{
+    for (auto uri : uris) {
+        auto job = m_jobs.value(uri);
+        // only jobs whose priority changes are requeued, and only jobs not started yet can be taken.
+        if (!job || job->priority == PRIORITY_VISIBLE)
+            continue;
+        job->priority = PRIORITY_VISIBLE;
+        if (m_pool.tryTake(job)) {
+            m_pool.start(job, PRIORITY_VISIBLE);
+        }
+    }
+}
+
+void ThumbnailProvider::cancel(const QString &uri)
+{
+    auto job = m_jobs.value(uri);
+    if (!job)
+        return;
+
+    if (m_pool.tryTake(job)) {
+        m_jobs.remove(uri);
+        delete job;
+    } else {
+        // running job can not be stopped, but it is not requeued any more.
+        job->supersededTime = -1;
+        job->supersededPrioritized = false;
+    }
+}
+
+void ThumbnailProvider::cancelAll()
+{
+    for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+        if (m_pool.tryTake(it.value())) {
+            delete it.value();
+            it = m_jobs.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+void ThumbnailProvider::onJobFinished(const QString &uri, const QImage &thumbnail)
+{
+    auto job = m_jobs.take(uri);
+    qint64 supersededTime = job? job->supersededTime: -1;
+    bool supersededPrioritized = job && job->supersededPrioritized;
+    delete job;
+
+    if (supersededTime >= 0) {
+        // file changed while the job was running, the thumbnail is already stale.
+        requestThumbnail(uri, supersededTime, supersededPrioritized);
+        return;
+    }
+
+    if (!thumbnail.isNull()) {
+        Q_EMIT thumbnailReady(uri, thumbnail);
+    }
+}
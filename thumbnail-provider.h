@@ -0,0 +1,41 @@
+#ifndef THUMBNAILPROVIDER_H
+#define THUMBNAILPROVIDER_H
+
+#include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QThreadPool>
+
+class ThumbnailJob;
+
+// generates thumbnails in a bounded thread pool, backed by the freedesktop
+// thumbnail cache (~/.cache/thumbnails/normal, keyed by uri and mtime).
+class ThumbnailProvider : public QObject
+{
+    Q_OBJECT
+    friend class ThumbnailJob;
+public:
+    explicit ThumbnailProvider(QObject *parent = nullptr);
+    ~ThumbnailProvider() override;
+
+    static bool canThumbnail(const QString &iconName);
+    static QString thumbnailUri(const QString &uri); //fully percent encoded uri, as Thumb::URI and cache key
+    static QString cachePath(const QString &uri);
+
+    void requestThumbnail(const QString &uri, qint64 modifiedTime, bool prioritized = false);
+    void prioritize(const QStringList &uris);
+    void cancel(const QString &uri);
+    void cancelAll();
+
+signals:
+    void thumbnailReady(const QString &uri, const QImage &thumbnail);
+
+private slots:
+    void onJobFinished(const QString &uri, const QImage &thumbnail);
+
+private:
+    QThreadPool m_pool;
+    QHash<QString, ThumbnailJob *> m_jobs;
+};
+
+#endif // THUMBNAILPROVIDER_H